@@ -5,6 +5,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include "wyoming_user.h"
 
 // region Microphone test impl
@@ -13,31 +14,48 @@ static pthread_t mic_thread;
 static atomic_int mic_enabled = ATOMIC_VAR_INIT(0);
 static atomic_int mic_play_audio = ATOMIC_VAR_INIT(0);
 
-static void* mic_thread_fn(void* opaque)
+// Fills `buffer` with test audio when it's playing, with silence otherwise
+static void mic_capture(uint8_t* buffer, uint32_t length)
 {
-  static uint8_t audio_buffer[2048];
   static FILE* audio_file = NULL;
-  while (atomic_load(&mic_enabled)) {
-    memset(audio_buffer, 0x0, sizeof(audio_buffer));
-    if (atomic_load(&mic_play_audio)) {
-      if (audio_file == NULL) {
+  size_t read_size = 0;
+  if (atomic_load(&mic_play_audio)) {
+    if (audio_file == NULL) {
 #if 1
-        audio_file = fopen("only-turn-on-light.raw", "rb");
+      audio_file = fopen("only-turn-on-light.raw", "rb");
 #else
-        audio_file = fopen("test-turn-on-the-light.raw", "rb");
+      audio_file = fopen("test-turn-on-the-light.raw", "rb");
 #endif
-      }
-      size_t read_size = fread(audio_buffer, 1, 2048, audio_file);
-      if (read_size <= 0) {
-        atomic_store(&mic_play_audio, 0);
-        fclose(audio_file);
-        audio_file = NULL;
-        printf("Test audio finished\n");
-      }
     }
-    wsat_mic_write_data(audio_buffer, sizeof(audio_buffer));
-    usleep(64 * 1000);
+    read_size = fread(buffer, 1, length, audio_file);
+    if (read_size <= 0) {
+      atomic_store(&mic_play_audio, 0);
+      fclose(audio_file);
+      audio_file = NULL;
+      printf("Test audio finished\n");
+    }
+  }
+  if (read_size < length) memset(buffer + read_size, 0x0, length - read_size);
+}
+
+static void* mic_thread_fn(void* opaque)
+{
+  static uint8_t audio_buffer[2048];
+  while (atomic_load(&mic_enabled)) {
+    // Audio is captured straight into chunk being gathered by library, if it can lend one
+    uint8_t* buffer;
+    uint32_t length;
+    if (wsat_mic_acquire_buffer(&buffer, &length)) {
+      mic_capture(buffer, length);
+      wsat_mic_commit(length);
+    } else {
+      length = sizeof(audio_buffer);
+      mic_capture(audio_buffer, length);
+      wsat_mic_write_data(audio_buffer, length);
+    }
+    usleep(length * 1000000ull / (16000 * 2)); // Same pace as real 16 kHz 16-bit microphone
   }
+  wsat_mic_flush();
   return NULL;
 }
 
@@ -93,6 +111,7 @@ static int32_t snd_handle_sys_event(enum wsat_sys_event_type type, void* data)
     fwrite(buffer->data, 1, buffer->size, snd_out_file);
     break;
   }
+  case WSAT_SYS_EVENT_SAT_DISCONNECT: // Playback, which was cut off, never ends
   case WSAT_SYS_EVENT_SND_AUDIO_END: {
     if (snd_out_file != NULL) {
       fclose(snd_out_file);
@@ -103,6 +122,22 @@ static int32_t snd_handle_sys_event(enum wsat_sys_event_type type, void* data)
   }
 }
 
+// Audio is read from the socket straight into this buffer, instead of going through WSAT_SYS_EVENT_SND_AUDIO_DATA
+static uint8_t snd_buffer[2048];
+
+static uint32_t snd_buffer_lend(uint8_t** buffer)
+{
+  *buffer = snd_buffer;
+  return sizeof(snd_buffer);
+}
+
+static void snd_buffer_commit(uint8_t* buffer, uint32_t size)
+{
+  if (snd_out_file != NULL) {
+    fwrite(buffer, 1, size, snd_out_file);
+  }
+}
+
 static struct wsat_sound snd = {
   {
     WSAT_COMPONENT_TYPE_SOUND,
@@ -110,7 +145,9 @@ static struct wsat_sound snd = {
     NULL,
     snd_handle_sys_event,
     true,
-  }
+  },
+  snd_buffer_lend,
+  snd_buffer_commit,
 };
 // endregion
 
@@ -137,10 +174,29 @@ void* terminal_thread_fn(void* opaque)
       atomic_store(&mic_play_audio, 1);
     } else if (ch == 'q') {
       printf("Stopping the server\n");
-      wsat_stop();
+      wsat_stop_wait();
+      printf("Server stopped\n");
       break;
     } else if (ch == 'w') {
       wsat_wake_detection();
+    } else if (ch == 's') {
+      struct wsat_stats stats;
+      wsat_stats_get(&stats);
+      const struct wsat_send_class_stats* classes[] = { &stats.send.control, &stats.send.bulk };
+      for (int i = 0; i < 2; i++) {
+        const struct wsat_send_class_stats* cls = classes[i];
+        printf("Send %s: queue %u bytes (max %u), %u dropped, %u late, latency avg %lu us, max %u us\n",
+               i == 0 ? "control" : "bulk", cls->queue_depth, cls->queue_high_water, cls->overload_drop_count,
+               cls->deadline_drop_count,
+               cls->sent_count > 0 ? (unsigned long)(cls->latency_total_us / cls->sent_count) : 0ul,
+               cls->latency_max_us);
+      }
+      printf("Send stalls: %u, %lu us total, %u us max, %u connections dropped\n",
+             stats.send.stall_count, (unsigned long)stats.send.stall_time_us, stats.send.stall_time_max_us,
+             stats.send.connection_drop_count);
+      printf("Mic chunk: %u bytes (%u ms), backlog %u bytes, rtt %u us, grown %u times, shrunk %u times\n",
+             stats.mic.chunk_size, stats.mic.chunk_ms, stats.mic.backlog_bytes, stats.mic.rtt_us,
+             stats.mic.grow_count, stats.mic.shrink_count);
     }
   }
   return NULL;
@@ -148,15 +204,14 @@ void* terminal_thread_fn(void* opaque)
 
 int main(int argc, char** argv)
 {
-  // Temporary workaround for tests
-#if 0
-  extern void test_wsat_decoder();
-  test_wsat_decoder();
-  return 0;
-#endif
   pthread_t terminal_thread;
   pthread_create(&terminal_thread, NULL, terminal_thread_fn, NULL);
-  wsat_init();
+  struct wsat_config config;
+  wsat_config_default_get(&config);
+  config.port = 10700;
+  config.send_buffer_size = 32 * 1024; // Few hundreds ms of audio, default buffers are way bigger
+  config.receive_buffer_size = 32 * 1024;
+  wsat_init(&config);
   wsat_mic_set(&mic);
   wsat_snd_set(&snd);
   wsat_wake_set(&wake);
@@ -173,4 +228,24 @@ void debug_print(char type, const char* format, ...)
   vprintf(format, args);
   printf("\n");
   va_end(args);
-}
\ No newline at end of file
+}
+
+uint64_t plat_time_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+int plat_sem_take_timeout(sem_t* sem, uint32_t timeout_ms)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += timeout_ms / 1000;
+  ts.tv_nsec += (timeout_ms % 1000) * 1000000l;
+  if (ts.tv_nsec >= 1000000000l) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000l;
+  }
+  return sem_timedwait(sem, &ts);
+}
@@ -3,12 +3,20 @@
 
 // System libraries
 #include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 // Include required libraries
 #include <cJSON.h>
 #include <sys/socket.h> // POSIX Sockets
+#include <sys/uio.h> // POSIX Sockets, scatter/gather reads
 #include <netinet/in.h> // POSIX Sockets
+#include <arpa/inet.h> // POSIX Sockets, parsing of listen address
 #include <unistd.h> // For Sockets
+#include <poll.h> // POSIX Sockets, waiting for sockets and wakeup channel
+#include <sys/ioctl.h> // Optional, bytes waiting in socket (TIOCOUTQ)
+#include <netinet/tcp.h> // Optional, TCP_NODELAY, keepalive and round-trip time of connection (TCP_INFO)
 
 // Logging implementation
 
@@ -31,7 +39,33 @@ void debug_print(char type, const char* format, ...);
 #define PLAT_MUTEX_LOCK(mutex) pthread_mutex_lock(mutex)
 #define PLAT_MUTEX_UNLOCK(mutex) pthread_mutex_unlock(mutex)
 
+#define PLAT_SEM_TYPE sem_t
+#define PLAT_SEM_CREATE(sem, initial) sem_init(sem, 0, initial)
+#define PLAT_SEM_DESTROY(sem) sem_destroy(sem)
+#define PLAT_SEM_TAKE(sem) while (sem_wait(sem) != 0) // Retried, as it can be interrupted by signal
+#define PLAT_SEM_GIVE(sem) sem_post(sem)
+int plat_sem_take_timeout(sem_t* sem, uint32_t timeout_ms);
+#define PLAT_SEM_TAKE_TIMEOUT(sem, timeout_ms) plat_sem_take_timeout(sem, timeout_ms)
+
+#define PLAT_THREAD_LOCAL _Thread_local
+
+uint64_t plat_time_us();
+#define PLAT_TIME_US() plat_time_us()
+
+#define PLAT_MALLOC(size) malloc(size)
+#define PLAT_FREE(ptr) free(ptr)
+
 #define EVENT_DECODER_BUFFER_SIZE (4096)
+// Bigger headers and data blocks are allocated on demand, up to this size
+#define EVENT_DECODER_SPILL_MAX_SIZE (64 * 1024)
+// Optional arena for cJSON nodes of one event, check wsat_stats_get for the size really needed
+#define WSAT_JSON_ARENA_SIZE (4096)
+// Events are sent by dedicated thread, so microphone never waits for network
+#define WSAT_SEND_QUEUE_SIZE (16 * 1024)
+// Microphone blocks are gathered into audio chunks of this duration, adapted to the link between the bounds
+#define WSAT_MIC_CHUNK_MS (40)
+#define WSAT_MIC_CHUNK_MIN_MS (20)
+#define WSAT_MIC_CHUNK_MAX_MS (80)
 
 
 #endif
\ No newline at end of file
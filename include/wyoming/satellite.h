@@ -5,11 +5,19 @@
 #include <cJSON.h>
 #include <stdbool.h>
 
+#ifndef WSAT_EVENT_TYPE_MAX_LENGTH
+#define WSAT_EVENT_TYPE_MAX_LENGTH (32)
+#endif
+
 enum wsat_error
 {
   WSAT_OK,
   WSAT_ERROR_SOCKET,
-  WSAT_ERROR_SAT_DISCONNECTED
+  WSAT_ERROR_SAT_DISCONNECTED,
+  WSAT_ERROR_EVENT_TOO_BIG,
+  WSAT_ERROR_SEND_QUEUE_FULL,
+  WSAT_ERROR_SEND_TIMEOUT,
+  WSAT_ERROR_THREAD_CREATE
 };
 
 enum wsat_decoded_event_flags
@@ -17,6 +25,7 @@ enum wsat_decoded_event_flags
   WSAT_DECODED_EVENT_FLAG_BEGIN = 1 << 0,
   WSAT_DECODED_EVENT_FLAG_PAYLOAD = 1 << 1,
   WSAT_DECODED_EVENT_FLAG_END = 1 << 2,
+  WSAT_DECODED_EVENT_FLAG_PAYLOAD_LENT = 1 << 3, // Payload chunk was read into buffer lent by sound component
 };
 
 enum wsat_component_type
@@ -30,29 +39,94 @@ enum wsat_component_type
 struct wsat_decoded_event
 {
   uint8_t flags; // enum wsat_decoded_event_flags
+  uint8_t packet_type; // enum wsat_packet_type, resolved from header type
   struct wsat_event_header
   {
-    cJSON* json;
-    const char* type;
-    cJSON* data;
+    char type[WSAT_EVENT_TYPE_MAX_LENGTH]; // Longer types are truncated
     uint32_t data_length;
     uint32_t payload_length;
   } header;
-  cJSON* data;
+  cJSON* data; // Parsed on demand by wsat_decoded_event_get_data, do not read directly
+  struct wsat_event_data_span
+  {
+    const char* json; // Raw data block in decoder buffer, valid only during handling of the event with BEGIN flag
+    uint32_t length;
+  } data_span;
   struct wsat_event_payload_chunk
   {
+    // Read-only view into decoder buffer (or lent buffer), valid only during handling of the event.
+    // Chunks out of decoder buffer start on EVENT_DECODER_PAYLOAD_ALIGNMENT boundary.
     uint8_t* data;
     uint32_t offset;
     uint32_t size;
   } payload;
 };
 
+struct wsat_decoder_stats
+{
+  uint32_t spill_header_count; // Headers, which didn't fit into decoder buffer
+  uint32_t spill_data_count; // Data blocks, which didn't fit into decoder buffer
+  uint32_t spill_high_water; // Biggest spill buffer usage so far
+  uint32_t spill_fail_count; // Headers and data blocks dropped, as they didn't fit even into spill buffer
+  uint32_t skip_count; // Events skipped without decoding, as nobody handles them
+  uint32_t resync_count; // Times the stream couldn't be interpreted, and decoder looked for next header start
+  uint32_t resync_skipped_bytes; // Bytes thrown away, as they were not part of any valid event
+  uint32_t payload_align_count; // Payloads, which were moved in decoder buffer to start aligned
+};
+
+struct wsat_json_arena_stats
+{
+  uint32_t high_water; // Most bytes used by one event, useful to size WSAT_JSON_ARENA_SIZE
+  uint32_t overflow_count; // Allocations, which didn't fit into arena and went to heap
+};
+
+// Outbound events are sent in two classes, control events (pong, info, detection...) go before queued audio
+struct wsat_send_class_stats
+{
+  uint32_t queue_depth; // Bytes waiting in send queue right now
+  uint32_t queue_high_water; // Most bytes waiting in send queue so far, useful to size the queue
+  uint32_t overload_drop_count; // Events dropped by overload policy, as there was no space in send queue or socket
+  uint32_t deadline_drop_count; // Events dropped, as they couldn't be written into socket before their deadline
+  uint32_t sent_count; // Events (or batches of them) written into socket
+  uint32_t latency_max_us; // Longest time from event being ready to being written into socket
+  uint64_t latency_total_us; // Divided by sent_count gives average latency
+};
+
+struct wsat_send_stats
+{
+  struct wsat_send_class_stats control;
+  struct wsat_send_class_stats bulk;
+  uint32_t stall_count; // Sends, which had to wait for space in socket buffer
+  uint32_t stall_time_max_us; // Longest of these waits
+  uint64_t stall_time_us; // Time spent waiting in total
+  uint32_t connection_drop_count; // Connections closed, as they were not able to receive events in time
+};
+
+// Audio chunk sizing, which follows the state of the link
+struct wsat_mic_stats
+{
+  uint32_t chunk_size; // Bytes of audio-chunk being gathered now
+  uint32_t chunk_ms; // Its duration
+  uint32_t backlog_bytes; // Last sampled bytes waiting in send queue and socket
+  uint32_t rtt_us; // Last sampled round-trip time of connection, 0 when it's not known
+  uint32_t grow_count; // Times chunk was made longer, as audio was piling up or round-trip was long
+  uint32_t shrink_count; // Times chunk was made shorter, as the link was idle
+};
+
+struct wsat_stats
+{
+  struct wsat_decoder_stats decoder;
+  struct wsat_json_arena_stats event_arena;
+  struct wsat_send_stats send;
+  struct wsat_mic_stats mic;
+};
+
 struct wsat_event
 {
   cJSON* header;
   cJSON* data;
   uint8_t* payload;
-  uint16_t payload_length;
+  uint32_t payload_length;
 };
 
 enum wsat_sys_event_type
@@ -100,24 +174,98 @@ struct wsat_microphone
 struct wsat_sound
 {
   struct wsat_component comp;
+  // Optional, lends buffer for incoming audio, so it's read from the socket straight into it.
+  // Returns size of the buffer, or 0 if none is available now, then audio goes through WSAT_SYS_EVENT_SND_AUDIO_DATA.
+  uint32_t (* buffer_lend_fn)(uint8_t** buffer);
+  // Returns lent buffer with `size` bytes of audio written. Called for every lent buffer, with 0 if read failed.
+  void (* buffer_commit_fn)(uint8_t* buffer, uint32_t size);
 };
 
 struct wsat_wake
 {
   struct wsat_component comp;
+  const char* name; // Name of the model, reported in detection
+  // Optional, reported in info event, defaults are used when NULL
+  const char* phrase; // Defaults to name
+  const char* model_description;
+  const char* model_version;
+  const char* model_attribution_name;
+  const char* model_attribution_url;
+  const char* const* languages; // Terminated by NULL
+  const char* engine_name;
+  const char* engine_description;
+  const char* engine_version;
+};
+
+// Runtime settings of the server, see wsat_config_default_get for defaults
+struct wsat_config
+{
+  const char* address; // Address to listen on, NULL is any. Path of Unix domain socket. Must stay valid.
+  uint16_t port; // 0 lets the system pick one
+  bool is_ipv6; // Listens on IPv6, when address is NULL also on IPv4 where the system allows it
+  bool is_nodelay; // Disables Nagle's algorithm, so small events (pong, detection) go out at once
+  uint32_t send_buffer_size; // SO_SNDBUF, 0 keeps the system default
+  uint32_t receive_buffer_size; // SO_RCVBUF, 0 keeps the system default
+  uint32_t keepalive_idle_s; // TCP keepalive probes start after this idle time, 0 derives it from peer_timeout_s
+  uint32_t keepalive_interval_s; // Time between probes, 0 keeps the system default
+  uint32_t keepalive_count; // Unanswered probes before connection is dropped, 0 keeps the system default
+  // Dead peer is dropped after this time: no ping since the last one, or data and keepalive probes left
+  // unacknowledged (TCP_USER_TIMEOUT). 0 disables it, and keepalive too when it isn't set above.
+  uint32_t peer_timeout_s;
+};
+
+struct iovec;
+
+// Transport carrying events, see satellite_transport.c. Handles are file descriptors for socket transports.
+// Writes don't block, -1 with errno EAGAIN means wait_fn has to be called first.
+struct wsat_transport
+{
   const char* name;
+  int (* listen_fn)(const struct wsat_config* config); // Returns listener handle, or -1
+  int (* accept_fn)(int listener, const struct wsat_config* config); // Returns connection handle, or -1 with errno
+  int32_t (* read_fn)(int conn, struct iovec* iov, uint32_t iov_count); // Returns 0, when peer closed connection
+  int32_t (* writev_fn)(int conn, struct iovec* iov, uint32_t iov_count, bool is_more);
+  // Waits until handle can be read (or accepted) or written, or `wakeup_fd` is readable. -1 timeout waits forever.
+  // Returns 1 when handle is ready, 0 on wakeup or timeout, -1 on error.
+  int (* wait_fn)(int handle, bool is_write, int wakeup_fd, int32_t timeout_ms);
+  void (* shutdown_fn)(int conn); // Ends connection, so server loop sees disconnect, called from other threads
+  void (* close_fn)(int handle);
+  void (* backlog_fn)(int conn, uint32_t* queued_bytes, uint32_t* rtt_us); // Optional, data not received by peer yet
 };
 
-int32_t wsat_init();
+extern const struct wsat_transport wsat_transport_tcp;
+extern const struct wsat_transport wsat_transport_unix;
+extern const struct wsat_transport wsat_transport_loopback;
+
+// Config is copied, NULL uses defaults
+int32_t wsat_init(const struct wsat_config* config);
+void wsat_config_default_get(struct wsat_config* config);
 void wsat_destroy();
 int32_t wsat_run();
 void wsat_stop();
+// Stops the server and waits until wsat_run returns, must not be called from callbacks of the library
+void wsat_stop_wait();
+// Components are picked up by the next wsat_run, which chooses the mode and renders info event for them
 void wsat_mic_set(struct wsat_microphone* mic);
 void wsat_snd_set(struct wsat_sound* snd);
 void wsat_wake_set(struct wsat_wake* wake);
 void wsat_mic_write_data(uint8_t* data, uint32_t length);
+// Sends microphone data gathered so far, call it from the same thread as wsat_mic_write_data, when capture stops
+void wsat_mic_flush();
+// Lends free space of the audio chunk being gathered, so capture driver writes into it, instead of own buffer.
+// Returns false, when nothing can be lent (WSAT_MIC_CHUNK_MS is 0), then wsat_mic_write_data must be used.
+bool wsat_mic_acquire_buffer(uint8_t** buffer, uint32_t* length);
+// Hands over `length` bytes written into lent buffer, it must not be touched anymore
+void wsat_mic_commit(uint32_t length);
 bool wsat_server_is_connected();
 void wsat_wake_detection();
+// Optional buffer for events bigger than EVENT_DECODER_BUFFER_SIZE, must be set before wsat_run
+void wsat_spill_buffer_set(uint8_t* buffer, uint32_t size);
+void wsat_stats_get(struct wsat_stats* stats);
+// Transport used by wsat_run, default is wsat_transport_tcp. Must be set before wsat_run.
+void wsat_transport_set(const struct wsat_transport* transport);
+// Connects to server running on wsat_transport_loopback, returned handle is used with its functions
+int wsat_transport_loopback_connect();
 
 int32_t wsat_event_send(struct wsat_event* evt);
 void wsat_event_free(struct wsat_event* evt, bool free_payload);
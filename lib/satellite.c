@@ -19,15 +19,35 @@
 
 struct wsat_inst_priv wsat_priv;
 
-int32_t wsat_init()
+void wsat_config_default_get(struct wsat_config* config)
+{
+  memset(config, 0, sizeof(*config));
+  config->port = 10700;
+  config->is_nodelay = true;
+  config->peer_timeout_s = 10; // Home Assistant pings every few seconds
+}
+
+int32_t wsat_init(const struct wsat_config* config)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_server* server = &inst->server;
   memset(inst, 0, sizeof(struct wsat_inst_priv));
+  if (config != NULL) {
+    inst->config = *config;
+  } else {
+    wsat_config_default_get(&inst->config);
+  }
   server->connfd = -1;
   server->sockfd = -1;
+  server->wakeup_fds[0] = server->wakeup_fds[1] = -1;
+  server->transport = &wsat_transport_tcp;
   PLAT_MUTEX_CREATE(&server->state_mutex); // TODO: Error check
   PLAT_MUTEX_CREATE(&server->send_mutex); // TODO: Error check
+  PLAT_MUTEX_CREATE(&server->run_mutex); // TODO: Error check
+#if WSAT_SEND_QUEUE_SIZE > 0
+  wsat_send_queue_init();
+#endif
+  wsat_json_arena_init();
   return 0;
 }
 
@@ -35,6 +55,12 @@ void wsat_destroy()
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_server* server = &inst->server;
+  wsat_event_decoder_reset(&server->decoder); // Frees spill buffer, if it was allocated
+  wsat_json_arena_destroy();
+#if WSAT_SEND_QUEUE_SIZE > 0
+  wsat_send_queue_destroy();
+#endif
+  PLAT_MUTEX_DESTROY(&server->run_mutex);
   PLAT_MUTEX_DESTROY(&server->send_mutex);
   PLAT_MUTEX_DESTROY(&server->state_mutex);
 }
@@ -43,6 +69,7 @@ int32_t wsat_run()
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   int32_t res = WSAT_OK;
+  PLAT_MUTEX_LOCK(&inst->server.run_mutex);
   if (inst->wake != NULL) {
     inst->mode = &wsat_mode_wake_stream;
   } else {
@@ -65,6 +92,11 @@ int32_t wsat_run()
       comp->is_init = true;
     }
   }
+  if (inst->mic != NULL) wsat_audio_chunk_init();
+  // Info describes components, which the mode was chosen for, so it follows them only here
+  wsat_info_render();
+  // Events, which are not handled by the mode or default handlers, are skipped already in decoder.
+  wsat_event_decoder_skip_set(&inst->server.decoder, ~wsat_event_interest_mask_get());
   res = wsat_server_run();
 cleanup:
   for (int i = 0; i < ARRAY_LENGTH(inst->components); i++) {
@@ -76,6 +108,7 @@ cleanup:
       comp->is_init = false;
     }
   }
+  PLAT_MUTEX_UNLOCK(&inst->server.run_mutex);
   return res;
 }
 
@@ -97,17 +130,52 @@ void wsat_wake_set(struct wsat_wake* wake)
   inst->wake = wake;
 }
 
+void wsat_spill_buffer_set(uint8_t* buffer, uint32_t size)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  wsat_event_decoder_spill_set(&inst->server.decoder, buffer, size);
+}
+
+void wsat_transport_set(const struct wsat_transport* transport)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  inst->server.transport = transport;
+}
+
+void wsat_stats_get(struct wsat_stats* stats)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  // Counters are only incremented by their owner threads, so they are just copied without locking.
+  memset(stats, 0, sizeof(*stats));
+  stats->decoder = inst->server.decoder.stats;
+#if WSAT_JSON_ARENA_SIZE > 0
+  stats->event_arena = inst->event_arena.stats;
+#endif
+  stats->send = inst->server.send_stats;
+#if WSAT_SEND_QUEUE_SIZE > 0
+  wsat_send_queue_stats_get(&stats->send);
+#endif
+#if WSAT_MIC_CHUNK_MS > 0
+  stats->mic = inst->mic_chunk.stats;
+#endif
+}
+
 void wsat_stop()
+{
+  wsat_server_stop_request();
+}
+
+void wsat_stop_wait()
 {
   struct wsat_inst_priv* inst = &wsat_priv;
-  struct wsat_server* server = &inst->server;
-  PLAT_MUTEX_LOCK(&server->state_mutex);
-  server->stop_requested = true;
-  PLAT_MUTEX_UNLOCK(&server->state_mutex);
-  // TODO: Semaphore to wait for shutdown
+  wsat_server_stop_request();
+  // wsat_run holds the mutex until everything is shut down
+  PLAT_MUTEX_LOCK(&inst->server.run_mutex);
+  PLAT_MUTEX_UNLOCK(&inst->server.run_mutex);
 }
 
-int32_t wsat_run_pipeline_send(const char* pipeline_name)
+// Queues run-pipeline into already started batch, so it can go out together with preceding event
+int32_t wsat_run_pipeline_write(const char* pipeline_name)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   const char* start_stage, * end_stage;
@@ -130,45 +198,186 @@ int32_t wsat_run_pipeline_send(const char* pipeline_name)
     end_stage = "handle";
   }
 
-  cJSON* header = cJSON_CreateObject();
-  cJSON_AddStringToObject(header, "type", "run-pipeline");
-  cJSON_AddStringToObject(header, "version", "1.5.2");
-
-  cJSON* data = cJSON_CreateObject();
-  if (pipeline_name != NULL) cJSON_AddStringToObject(data, "name", pipeline_name);
-  cJSON_AddStringToObject(data, "start_stage", start_stage);
-  cJSON_AddStringToObject(data, "end_stage", end_stage);
-  cJSON_AddBoolToObject(data, "restart_on_end", restart_on_end);
-
-  struct wsat_event res_pkt = {
-    .header = header,
-    .data = data
-  };
-  int32_t res = wsat_event_send(&res_pkt);
-  wsat_event_free(&res_pkt, false);
-  return res;
+  struct wsat_json_writer* data = wsat_event_batch_write_begin();
+  wsat_json_writer_object_begin(data, NULL);
+  if (pipeline_name != NULL) wsat_json_writer_string(data, "name", pipeline_name);
+  wsat_json_writer_string(data, "start_stage", start_stage);
+  wsat_json_writer_string(data, "end_stage", end_stage);
+  wsat_json_writer_bool(data, "restart_on_end", restart_on_end);
+  wsat_json_writer_object_end(data);
+  static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("run-pipeline", "1.5.2");
+  return wsat_event_batch_write_end(header, sizeof(header) - 1, NULL, 0);
+}
+
+int32_t wsat_run_pipeline_send(const char* pipeline_name)
+{
+  if (!wsat_event_batch_begin(WSAT_SEND_CLASS_CONTROL)) return -WSAT_ERROR_SAT_DISCONNECTED;
+  wsat_run_pipeline_write(pipeline_name);
+  return wsat_event_batch_end();
+}
+
+#if WSAT_MIC_CHUNK_MS > 0
+// Bytes of whole frames for given duration, limited by chunk buffer. Frames are never split between chunks.
+static uint32_t wsat_audio_chunk_size_get(uint32_t duration_ms)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  uint64_t size = (uint64_t)chunk->bytes_per_second * duration_ms / 1000;
+  if (size > sizeof(chunk->buffer)) size = sizeof(chunk->buffer);
+  size -= size % chunk->frame_size;
+  return size > 0 ? (uint32_t)size : chunk->frame_size;
+}
+#endif
+
+// Microphone format doesn't change, so data template and chunk size are worked out once
+void wsat_audio_chunk_init()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+#if WSAT_MIC_CHUNK_MS > 0
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  chunk->frame_size = (uint32_t)inst->mic->width * inst->mic->channels;
+  if (chunk->frame_size == 0) chunk->frame_size = 1;
+  chunk->bytes_per_second = inst->mic->rate * chunk->frame_size;
+  if (chunk->bytes_per_second == 0) chunk->bytes_per_second = 1;
+  if ((uint64_t)chunk->bytes_per_second * WSAT_MIC_CHUNK_MAX_MS / 1000 > sizeof(chunk->buffer)) {
+    LOGE("Audio chunk of %d ms doesn't fit into %d bytes, shortened", WSAT_MIC_CHUNK_MAX_MS,
+         (int)sizeof(chunk->buffer));
+  }
+  chunk->min_size = wsat_audio_chunk_size_get(WSAT_MIC_CHUNK_MIN_MS);
+  chunk->max_size = wsat_audio_chunk_size_get(WSAT_MIC_CHUNK_MAX_MS);
+  chunk->size = wsat_audio_chunk_size_get(WSAT_MIC_CHUNK_MS);
+  chunk->used = 0;
+  memset(&chunk->stats, 0, sizeof(chunk->stats));
+  chunk->stats.chunk_size = chunk->size;
+  chunk->stats.chunk_ms = (uint32_t)((uint64_t)chunk->size * 1000 / chunk->bytes_per_second);
+#endif
+  struct wsat_json_writer writer;
+  wsat_json_writer_init(&writer, inst->audio_chunk_data_template, sizeof(inst->audio_chunk_data_template));
+  wsat_json_writer_object_begin(&writer, NULL);
+  wsat_json_writer_uint(&writer, "rate", inst->mic->rate);
+  wsat_json_writer_uint(&writer, "width", inst->mic->width);
+  wsat_json_writer_uint(&writer, "channels", inst->mic->channels);
+  wsat_json_writer_raw(&writer, ",\"timestamp\":", 13);
+  inst->audio_chunk_data_template_length = writer.length;
 }
 
 int32_t wsat_audio_chunk_send(uint8_t* data, uint32_t length)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
-  cJSON* header = cJSON_CreateObject();
-  cJSON_AddStringToObject(header, "type", "audio-chunk");
-  cJSON_AddStringToObject(header, "version", "1.5.2");
-
-  cJSON* evt_data = cJSON_CreateObject();
-  cJSON_AddNumberToObject(evt_data, "rate", inst->mic->rate);
-  cJSON_AddNumberToObject(evt_data, "width", inst->mic->width);
-  cJSON_AddNumberToObject(evt_data, "channels", inst->mic->channels);
-  cJSON_AddNumberToObject(evt_data, "timestamp", 4407203886274); // TODO:
-
-  struct wsat_event res_pkt = {
-    .header = header,
-    .data = evt_data,
-    .payload = data,
-    .payload_length = length
-  };
-  int32_t res = wsat_event_send(&res_pkt);
-  wsat_event_free(&res_pkt, false);
-  return res;
-}
\ No newline at end of file
+  // Only timestamp changes between chunks, rest of the data is copied from template.
+  struct wsat_json_writer* evt_data = wsat_event_write_begin(WSAT_SEND_CLASS_BULK);
+  if (evt_data == NULL) return -WSAT_ERROR_SAT_DISCONNECTED;
+  wsat_json_writer_raw(evt_data, inst->audio_chunk_data_template, inst->audio_chunk_data_template_length);
+  wsat_json_writer_uint_value(evt_data, 4407203886274); // TODO:
+  wsat_json_writer_raw(evt_data, "}", 1);
+  static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("audio-chunk", "1.5.2");
+  return wsat_event_write_end(header, sizeof(header) - 1, data, length);
+}
+
+#if WSAT_MIC_CHUNK_MS > 0 && WSAT_MIC_CHUNK_MIN_MS != WSAT_MIC_CHUNK_MAX_MS
+// Picks duration of next chunk from the audio still waiting to be received by server and round-trip time.
+// It's sampled right before complete chunk is sent, so the previous one had whole chunk duration to get through.
+// Thresholds leave gap between growing and shrinking, so the size doesn't swing with every sample.
+static void wsat_audio_chunk_adapt()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  uint32_t backlog_bytes, rtt_us;
+  wsat_send_backlog_sample(&backlog_bytes, &rtt_us);
+  chunk->stats.backlog_bytes = backlog_bytes;
+  chunk->stats.rtt_us = rtt_us;
+  const uint64_t chunk_us = (uint64_t)chunk->size * 1000000 / chunk->bytes_per_second;
+  const uint64_t backlog_us = (uint64_t)backlog_bytes * 1000000 / chunk->bytes_per_second;
+  uint32_t size = chunk->size;
+  if ((backlog_us > chunk_us || rtt_us > 2 * chunk_us) && size < chunk->max_size) {
+    size = size * 2 < chunk->max_size ? size * 2 : chunk->max_size;
+    chunk->stats.grow_count++;
+  } else if (backlog_us < chunk_us / 4 && rtt_us < chunk_us / 2 && size > chunk->min_size) {
+    size = size / 2 > chunk->min_size ? size / 2 : chunk->min_size;
+    chunk->stats.shrink_count++;
+  } else {
+    return;
+  }
+  chunk->size = size - size % chunk->frame_size;
+  chunk->stats.chunk_size = chunk->size;
+  chunk->stats.chunk_ms = (uint32_t)((uint64_t)chunk->size * 1000 / chunk->bytes_per_second);
+}
+#else
+#define wsat_audio_chunk_adapt()
+#endif
+
+// Gathers microphone data into chunks of current duration. Data already forming whole chunk are sent without copying.
+int32_t wsat_audio_chunk_write(uint8_t* data, uint32_t length)
+{
+#if WSAT_MIC_CHUNK_MS > 0
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  int32_t ret = WSAT_OK;
+  while (length > 0) {
+    int32_t res = WSAT_OK;
+    if (chunk->used == 0 && length >= chunk->size) {
+      const uint32_t send_length = chunk->size;
+      wsat_audio_chunk_adapt();
+      res = wsat_audio_chunk_send(data, send_length);
+      data += send_length;
+      length -= send_length;
+    } else {
+      const uint32_t copy_length = chunk->size - chunk->used < length ? chunk->size - chunk->used : length;
+      // Data written into lent buffer are already in place, unless the chunk was discarded meanwhile, then they are
+      // moved to its start, which can overlap them
+      if (data != chunk->buffer + chunk->used) memmove(chunk->buffer + chunk->used, data, copy_length);
+      chunk->used += copy_length;
+      data += copy_length;
+      length -= copy_length;
+      if (chunk->used == chunk->size) {
+        wsat_audio_chunk_adapt();
+        res = wsat_audio_chunk_flush();
+      }
+    }
+    // Audio is real-time, so the rest is still sent, even if one chunk was dropped
+    if (res < 0 && ret == WSAT_OK) ret = res;
+  }
+  return ret;
+#else
+  return wsat_audio_chunk_send(data, length);
+#endif
+}
+
+// Free space of chunk being gathered. Data written there are only counted in by wsat_audio_chunk_write, so when
+// they are not streamed, they are just overwritten later.
+bool wsat_audio_chunk_lend(uint8_t** buffer, uint32_t* length)
+{
+#if WSAT_MIC_CHUNK_MS > 0
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  if (chunk->size == 0) return false; // Microphone was not set up yet
+  *buffer = chunk->buffer + chunk->used;
+  *length = chunk->size - chunk->used;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Sends partially gathered chunk, it's dropped if sending fails
+int32_t wsat_audio_chunk_flush()
+{
+#if WSAT_MIC_CHUNK_MS > 0
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mic_chunk* chunk = &inst->mic_chunk;
+  if (chunk->used == 0) return WSAT_OK;
+  const int32_t ret = wsat_audio_chunk_send(chunk->buffer, chunk->used);
+  chunk->used = 0;
+  return ret;
+#else
+  return WSAT_OK;
+#endif
+}
+
+// Drops partially gathered chunk, must be called by the thread calling wsat_mic_write_data, which owns the chunk
+void wsat_audio_chunk_discard()
+{
+#if WSAT_MIC_CHUNK_MS > 0
+  wsat_priv.mic_chunk.used = 0;
+#endif
+}
@@ -13,6 +13,25 @@ void wsat_mic_write_data(uint8_t* data, uint32_t length)
   inst->mode->component.sys_event_handle_fn(WSAT_SYS_EVENT_MIC_DATA, &arg);
 }
 
+bool wsat_mic_acquire_buffer(uint8_t** buffer, uint32_t* length)
+{
+  return wsat_audio_chunk_lend(buffer, length);
+}
+
+void wsat_mic_commit(uint32_t length)
+{
+  uint8_t* buffer;
+  uint32_t lent_length;
+  if (!wsat_audio_chunk_lend(&buffer, &lent_length)) return;
+  // Goes through the mode like any other data, chunk recognizes them as already being in place
+  wsat_mic_write_data(buffer, length < lent_length ? length : lent_length);
+}
+
+void wsat_mic_flush()
+{
+  wsat_audio_chunk_flush();
+}
+
 void wsat_wake_detection()
 {
   struct wsat_inst_priv* inst = &wsat_priv;
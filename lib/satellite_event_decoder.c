@@ -2,116 +2,659 @@
 
 #include "satellite_priv.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Decoder keeps received bytes in a ring buffer with separate read and write positions,
+ * so consumed bytes never need to be moved. Payload chunks are handed out as views into the ring,
+ * split at its end. Only header and data blocks must be contiguous for parsing, so when one of them
+ * wraps around the end of the ring, it is moved to the start of the buffer once.
+ * Payload starts on EVENT_DECODER_PAYLOAD_ALIGNMENT boundary, bytes behind its header are moved forward to reach it.
+ */
+
+_Static_assert(EVENT_DECODER_BUFFER_SIZE % EVENT_DECODER_PAYLOAD_ALIGNMENT == 0,
+               "Decoder buffer must be multiple of payload alignment");
+
+// Frees spill buffer, if it was allocated by decoder
+static void wsat_event_decoder_spill_free(struct wsat_event_decoder* dec)
+{
+  dec->spill.length = 0;
+  if (dec->spill.is_external || dec->spill.data == NULL) return;
+#if EVENT_DECODER_SPILL_MAX_SIZE > 0
+  PLAT_FREE(dec->spill.data);
+#endif
+  dec->spill.data = NULL;
+  dec->spill.capacity = 0;
+}
+
 void wsat_event_decoder_reset(struct wsat_event_decoder* dec)
 {
   dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
+  dec->header_scanned = 0;
+  dec->read_pos = 0;
+  dec->write_pos = 0;
   dec->buffer_length = 0;
+  // Event can be left unfinished, e.g. by disconnect in the middle of payload
+  if (dec->wip_evt.data != NULL) cJSON_Delete(dec->wip_evt.data);
   memset(&dec->wip_evt, 0, sizeof(dec->wip_evt));
   dec->payload_received = 0;
+  dec->skip_length = 0;
+  wsat_event_decoder_spill_free(dec);
+}
+
+void wsat_event_decoder_skip_set(struct wsat_event_decoder* dec, uint32_t skip_mask)
+{
+  dec->skip_mask = skip_mask;
 }
 
-uint32_t wsat_event_decoder_buffer_get(struct wsat_event_decoder* dec, uint8_t** buffer)
+uint32_t wsat_event_decoder_buffer_get(struct wsat_event_decoder* dec, struct wsat_buffer_region regions[2])
 {
-  *buffer = dec->buffer + dec->buffer_length;
-  return EVENT_DECODER_BUFFER_SIZE - dec->buffer_length;
+  const uint32_t free_length = EVENT_DECODER_RING_CAPACITY - dec->buffer_length;
+  if (free_length == 0) return 0;
+  const uint32_t to_end = EVENT_DECODER_BUFFER_SIZE - dec->write_pos;
+  regions[0].data = dec->buffer + dec->write_pos;
+  if (free_length <= to_end) {
+    regions[0].length = free_length;
+    return 1;
+  }
+  regions[0].length = to_end;
+  regions[1].data = dec->buffer;
+  regions[1].length = free_length - to_end;
+  return 2;
 }
 
 void wsat_event_decoder_buffer_advance(struct wsat_event_decoder* dec, uint32_t length)
 {
-  dec->buffer_length += length; // TODO: Add check if it's not more than allowed.
+  const uint32_t free_length = EVENT_DECODER_RING_CAPACITY - dec->buffer_length;
+  if (length > free_length) {
+    LOGE("Decoder advanced by %d bytes, but only %d are free", length, free_length);
+    length = free_length;
+  }
+  dec->write_pos = (dec->write_pos + length) % EVENT_DECODER_BUFFER_SIZE;
+  dec->buffer_length += length;
+}
+
+// Returns how many unprocessed bytes are available from read position without wrapping
+static uint32_t wsat_event_decoder_contiguous_length(struct wsat_event_decoder* dec)
+{
+  const uint32_t to_end = EVENT_DECODER_BUFFER_SIZE - dec->read_pos;
+  return dec->buffer_length < to_end ? dec->buffer_length : to_end;
+}
+
+static void wsat_event_decoder_consume(struct wsat_event_decoder* dec, uint32_t length)
+{
+  if (length == 0) return;
+  // Scan progress is relative to read position, so it's not valid anymore.
+  dec->header_scanned = 0;
+  dec->read_pos = (dec->read_pos + length) % EVENT_DECODER_BUFFER_SIZE;
+  dec->buffer_length -= length;
+  if (dec->buffer_length == 0) {
+    // Nothing is buffered, start from beginning, so next read lands on aligned and contiguous space.
+    dec->read_pos = 0;
+    dec->write_pos = 0;
+  }
+}
+
+// Moves unprocessed bytes forward by `shift`, so payload starting at read position is aligned.
+// Bytes are moved from the end, in pieces which don't cross end of the ring. Free space past write position
+// is used, so data block consumed right before payload stays untouched.
+static void wsat_event_decoder_payload_align(struct wsat_event_decoder* dec)
+{
+  const uint32_t shift = (EVENT_DECODER_PAYLOAD_ALIGNMENT - dec->read_pos % EVENT_DECODER_PAYLOAD_ALIGNMENT) %
+                         EVENT_DECODER_PAYLOAD_ALIGNMENT;
+  if (shift == 0) return;
+  // Positions are not wrapped here, so pieces are easier to find
+  uint32_t end = dec->read_pos + dec->buffer_length;
+  while (end > dec->read_pos) {
+    uint32_t start = dec->read_pos;
+    const uint32_t src_boundary = (end - 1) / EVENT_DECODER_BUFFER_SIZE * EVENT_DECODER_BUFFER_SIZE;
+    const uint32_t dst_boundary = (end + shift - 1) / EVENT_DECODER_BUFFER_SIZE * EVENT_DECODER_BUFFER_SIZE;
+    if (start < src_boundary) start = src_boundary;
+    if (dst_boundary > shift && start < dst_boundary - shift) start = dst_boundary - shift;
+    memmove(dec->buffer + (start + shift) % EVENT_DECODER_BUFFER_SIZE, dec->buffer + start % EVENT_DECODER_BUFFER_SIZE,
+            end - start);
+    end = start;
+  }
+  dec->read_pos = (dec->read_pos + shift) % EVENT_DECODER_BUFFER_SIZE;
+  dec->write_pos = (dec->write_pos + shift) % EVENT_DECODER_BUFFER_SIZE;
+  dec->stats.payload_align_count++;
+}
+
+// Throws away bytes, which are not part of any valid event
+static void wsat_event_decoder_drop(struct wsat_event_decoder* dec, uint32_t length)
+{
+  dec->stats.resync_skipped_bytes += length;
+  wsat_event_decoder_consume(dec, length);
+}
+
+// Stream can't be interpreted from current position, so everything collected for current event is dropped,
+// together with `length` bytes in the ring. Header scan then continues from the next `{"`,
+// so valid events following the garbage are kept.
+static void wsat_event_decoder_resync(struct wsat_event_decoder* dec, uint32_t length)
+{
+  dec->stats.resync_count++;
+  dec->stats.resync_skipped_bytes += dec->spill.length;
+  dec->spill.length = 0;
+  wsat_event_decoder_drop(dec, length);
+  dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
+}
+
+// Returns first occurrence of `byte`, or NULL. Same as memchr, but doesn't rely on libc being vectorized,
+// which is often not the case on embedded platforms.
+static const uint8_t* wsat_find_byte(const uint8_t* data, uint32_t length, uint8_t byte)
+{
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  const __m128i needle = _mm_set1_epi8((char)byte);
+  for (; i + 16 <= length; i += 16) {
+    const __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask != 0) return data + i + __builtin_ctz((unsigned int)mask);
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t needle = vdupq_n_u8(byte);
+  for (; i + 16 <= length; i += 16) {
+    const uint8x16_t matches = vceqq_u8(vld1q_u8(data + i), needle);
+    if (vmaxvq_u8(matches) != 0) {
+      // Narrow every byte of the comparison result to 4 bits, so the position can be found in one 64-bit value.
+      const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+      return data + i + (__builtin_ctzll(mask) >> 2);
+    }
+  }
+#endif
+  // Portable fallback, also handles the tail shorter than one vector
+  return memchr(data + i, byte, length - i);
+}
+
+// Returns first occurrence of `first` followed by `second`, or NULL. Used instead of memmem, which is not in C standard.
+const uint8_t* wsat_find_byte_pair(const uint8_t* data, uint32_t length, uint8_t first, uint8_t second)
+{
+  uint32_t offset = 0;
+  while (offset + 1 < length) {
+    // Last byte can't start the pair, so it's left out of the search
+    const uint8_t* found = wsat_find_byte(data + offset, length - offset - 1, first);
+    if (found == NULL) return NULL;
+    if (found[1] == second) return found;
+    offset = found - data + 1;
+  }
+  return NULL;
+}
+
+// Finds end of the header `}\n`, continuing where previous unsuccessful search ended.
+static uint8_t* wsat_event_decoder_find_header_end(struct wsat_event_decoder* dec,
+                                                   uint8_t* header_start, uint32_t length)
+{
+  // `{` of the header can't be the `}`, so start at least after it.
+  uint32_t offset = dec->header_scanned > 1 ? dec->header_scanned : 1;
+  while (offset < length) {
+    const uint8_t* newline = wsat_find_byte(header_start + offset, length - offset, '\n');
+    if (newline == NULL) break;
+    offset = newline - header_start;
+    if (header_start[offset - 1] == '}') {
+      return header_start + offset - 1;
+    }
+    offset++;
+  }
+  dec->header_scanned = length;
+  return NULL;
+}
+
+void wsat_event_decoder_spill_set(struct wsat_event_decoder* dec, uint8_t* buffer, uint32_t size)
+{
+  wsat_event_decoder_spill_free(dec);
+  dec->spill.data = buffer;
+  dec->spill.capacity = buffer != NULL ? size : 0;
+  dec->spill.is_external = buffer != NULL;
+}
+
+static uint32_t wsat_event_decoder_spill_max_size(struct wsat_event_decoder* dec)
+{
+  return dec->spill.is_external ? dec->spill.capacity : EVENT_DECODER_SPILL_MAX_SIZE;
+}
+
+// Appends bytes to spill buffer, growing it up to EVENT_DECODER_SPILL_MAX_SIZE, if it's not provided by user.
+static bool wsat_event_decoder_spill_append(struct wsat_event_decoder* dec, const uint8_t* data, uint32_t length)
+{
+  const uint32_t needed = dec->spill.length + length;
+  if (needed > dec->spill.capacity) {
+#if EVENT_DECODER_SPILL_MAX_SIZE > 0
+    if (dec->spill.is_external || needed > EVENT_DECODER_SPILL_MAX_SIZE) return false;
+    uint32_t capacity = dec->spill.capacity > 0 ? dec->spill.capacity : EVENT_DECODER_BUFFER_SIZE;
+    while (capacity < needed) capacity *= 2;
+    if (capacity > EVENT_DECODER_SPILL_MAX_SIZE) capacity = EVENT_DECODER_SPILL_MAX_SIZE;
+    uint8_t* spill_data = PLAT_MALLOC(capacity);
+    if (spill_data == NULL) {
+      LOGE("Failed to allocate spill buffer of %d bytes", capacity);
+      return false;
+    }
+    if (dec->spill.data != NULL) {
+      memcpy(spill_data, dec->spill.data, dec->spill.length);
+      PLAT_FREE(dec->spill.data);
+    }
+    dec->spill.data = spill_data;
+    dec->spill.capacity = capacity;
+#else
+    return false;
+#endif
+  }
+  memcpy(dec->spill.data + dec->spill.length, data, length);
+  dec->spill.length = needed;
+  if (needed > dec->stats.spill_high_water) dec->stats.spill_high_water = needed;
+  return true;
+}
+
+// Moves next part of header, which didn't fit into the ring, to spill buffer.
+// Bytes are moved only up to newline, so nothing behind the header ends up there.
+// Returns 1 when whole header is in spill buffer, 0 when more bytes are needed, or -1 if it doesn't fit.
+static int32_t wsat_event_decoder_spill_header(struct wsat_event_decoder* dec)
+{
+  uint8_t* buffer = dec->buffer + dec->read_pos;
+  const uint32_t buffer_length = wsat_event_decoder_contiguous_length(dec);
+  const uint8_t* newline = wsat_find_byte(buffer, buffer_length, '\n');
+  const uint32_t length = newline != NULL ? newline - buffer + 1 : buffer_length;
+  if (!wsat_event_decoder_spill_append(dec, buffer, length)) return -1;
+  wsat_event_decoder_consume(dec, length);
+  if (newline == NULL || dec->spill.data[dec->spill.length - 2] != '}') return 0;
+  return 1;
+}
+
+/**
+ * Minimal streaming JSON scanner for event headers. It pulls out only the fields the decoder needs,
+ * so no cJSON tree has to be allocated for every received event. Values of other fields are skipped,
+ * validating just enough to find where they end.
+ */
+
+struct wsat_json_cursor
+{
+  const uint8_t* data;
+  uint32_t length;
+  uint32_t pos;
+};
+
+static void wsat_json_skip_ws(struct wsat_json_cursor* cur)
+{
+  while (cur->pos < cur->length) {
+    const uint8_t ch = cur->data[cur->pos];
+    if (ch != ' ' && ch != '\t' && ch != '\r' && ch != '\n') break;
+    cur->pos++;
+  }
+}
+
+static bool wsat_json_expect(struct wsat_json_cursor* cur, uint8_t ch)
+{
+  wsat_json_skip_ws(cur);
+  if (cur->pos >= cur->length || cur->data[cur->pos] != ch) return false;
+  cur->pos++;
+  return true;
+}
+
+// Skips string at cursor, returning its raw (still escaped) content
+static bool wsat_json_string(struct wsat_json_cursor* cur, const uint8_t** content, uint32_t* content_length)
+{
+  if (!wsat_json_expect(cur, '"')) return false;
+  const uint32_t start = cur->pos;
+  while (cur->pos < cur->length) {
+    const uint8_t ch = cur->data[cur->pos];
+    if (ch == '"') {
+      *content = cur->data + start;
+      *content_length = cur->pos - start;
+      cur->pos++;
+      return true;
+    }
+    if (ch < 0x20) return false;
+    cur->pos += ch == '\\' ? 2 : 1;
+  }
+  cur->pos = cur->length;
+  return false;
+}
+
+static bool wsat_json_skip_value(struct wsat_json_cursor* cur)
+{
+  uint32_t depth = 0;
+  do {
+    wsat_json_skip_ws(cur);
+    if (cur->pos >= cur->length) return false;
+    const uint8_t ch = cur->data[cur->pos];
+    if (ch == '"') {
+      const uint8_t* content;
+      uint32_t content_length;
+      if (!wsat_json_string(cur, &content, &content_length)) return false;
+    } else if (ch == '{' || ch == '[') {
+      depth++;
+      cur->pos++;
+    } else if (ch == '}' || ch == ']') {
+      if (depth == 0) return false;
+      depth--;
+      cur->pos++;
+    } else if (ch == ',' || ch == ':') {
+      if (depth == 0) return false;
+      cur->pos++;
+    } else {
+      // Number or literal
+      const uint32_t start = cur->pos;
+      while (cur->pos < cur->length) {
+        const uint8_t c = cur->data[cur->pos];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E')) break;
+        cur->pos++;
+      }
+      if (cur->pos == start) return false;
+    }
+  } while (depth > 0);
+  return true;
+}
+
+// Only non-negative integers are accepted, as that's what lengths are
+static bool wsat_json_uint(struct wsat_json_cursor* cur, uint32_t* value)
+{
+  wsat_json_skip_ws(cur);
+  uint64_t result = 0;
+  const uint32_t start = cur->pos;
+  while (cur->pos < cur->length && cur->data[cur->pos] >= '0' && cur->data[cur->pos] <= '9') {
+    result = result * 10 + (cur->data[cur->pos] - '0');
+    if (result > UINT32_MAX) return false;
+    cur->pos++;
+  }
+  if (cur->pos == start) return false;
+  if (cur->pos < cur->length && (cur->data[cur->pos] == '.' || (cur->data[cur->pos] | 0x20) == 'e')) return false;
+  *value = (uint32_t)result;
+  return true;
+}
+
+static bool wsat_json_key_equals(const uint8_t* key, uint32_t key_length, const char* expected)
+{
+  return key_length == strlen(expected) && memcmp(key, expected, key_length) == 0;
+}
+
+static void wsat_event_header_type_set(struct wsat_event_header* header, const uint8_t* type, uint32_t type_length)
+{
+  uint32_t length = 0;
+  for (uint32_t i = 0; i < type_length && length < sizeof(header->type) - 1; i++) {
+    uint8_t ch = type[i];
+    if (ch == '\\' && i + 1 < type_length) {
+      // Types are plain ASCII, so just simple escapes are resolved
+      ch = type[++i];
+      if (ch == 'n') ch = '\n';
+      else if (ch == 't') ch = '\t';
+    }
+    header->type[length++] = (char)ch;
+  }
+  header->type[length] = '\0';
+}
+
+// Known event types, placed in a perfect hash table, so resolving type costs one hash and one strcmp.
+// The hash uses only length, first and last character. Its multipliers were found by brute-force search,
+// when adding new type, search for new ones, so no two types share a slot.
+#define WSAT_PACKET_TYPE_HASH(length, first, last) (((length) * 2 + (first) * 4 + (last) * 7) & 15)
+
+struct packet_type_map_entry
+{
+  const char* type_str;
+  enum wsat_packet_type type_enum;
+};
+
+static const struct packet_type_map_entry packet_type_map[16] = {
+  [WSAT_PACKET_TYPE_HASH(8, 'd', 'e')] =  { "describe",        WSAT_EVENT_TYPE_DESCRIBE },
+  [WSAT_PACKET_TYPE_HASH(4, 'p', 'g')] =  { "ping",            WSAT_EVENT_TYPE_PING },
+  [WSAT_PACKET_TYPE_HASH(13, 'r', 'e')] = { "run-satellite",   WSAT_EVENT_TYPE_RUN_SATELLITE },
+  [WSAT_PACKET_TYPE_HASH(15, 'p', 'e')] = { "pause-satellite", WSAT_EVENT_TYPE_PAUSE_SATELLITE },
+  [WSAT_PACKET_TYPE_HASH(11, 'a', 't')] = { "audio-start",     WSAT_EVENT_TYPE_AUDIO_START },
+  [WSAT_PACKET_TYPE_HASH(11, 'a', 'k')] = { "audio-chunk",     WSAT_EVENT_TYPE_AUDIO_CHUNK },
+  [WSAT_PACKET_TYPE_HASH(10, 'a', 'p')] = { "audio-stop",      WSAT_EVENT_TYPE_AUDIO_STOP },
+  [WSAT_PACKET_TYPE_HASH(9, 'd', 'n')] =  { "detection",       WSAT_EVENT_TYPE_DETECTION },
+  [WSAT_PACKET_TYPE_HASH(13, 'v', 'd')] = { "voice-stopped",   WSAT_EVENT_TYPE_VOICE_STOPPED },
+  [WSAT_PACKET_TYPE_HASH(5, 'e', 'r')] =  { "error",           WSAT_EVENT_TYPE_ERROR },
+  [WSAT_PACKET_TYPE_HASH(10, 't', 't')] = { "transcript",      WSAT_EVENT_TYPE_TRANSCRIPT },
+};
+
+enum wsat_packet_type wsat_packet_type_get(const char* type)
+{
+  const size_t length = strlen(type);
+  if (length == 0) return WSAT_EVENT_TYPE_NONE;
+  const struct packet_type_map_entry* entry =
+    &packet_type_map[WSAT_PACKET_TYPE_HASH(length, (uint8_t)type[0], (uint8_t)type[length - 1])];
+  if (entry->type_str == NULL || strcmp(type, entry->type_str) != 0) return WSAT_EVENT_TYPE_NONE;
+  return entry->type_enum;
 }
 
-int32_t wsat_event_decoder_next(struct wsat_event_decoder* dec, struct wsat_decoded_event* out_event)
+enum wsat_event_header_tokenize_result
+{
+  WSAT_EVENT_HEADER_TOKENIZE_OK,
+  WSAT_EVENT_HEADER_TOKENIZE_NOT_JSON, // Not a JSON object at all, `end` points where it failed
+  WSAT_EVENT_HEADER_TOKENIZE_INVALID, // JSON object, but not valid event header
+};
+
+// Tokenizes header object, `end` is set to position after its closing `}`.
+static enum wsat_event_header_tokenize_result wsat_event_header_tokenize(const uint8_t* data, uint32_t length,
+                                                                         struct wsat_event_header* header,
+                                                                         uint32_t* end)
+{
+  struct wsat_json_cursor cur = { data, length, 0 };
+  bool is_valid = true, has_type = false;
+  memset(header, 0, sizeof(*header));
+  if (!wsat_json_expect(&cur, '{')) goto not_json;
+  while (true) {
+    const uint8_t* key;
+    uint32_t key_length;
+    if (!wsat_json_string(&cur, &key, &key_length)) goto not_json;
+    if (!wsat_json_expect(&cur, ':')) goto not_json;
+    wsat_json_skip_ws(&cur);
+    const uint32_t value_start = cur.pos;
+    bool is_known = true, is_parsed = false;
+    if (wsat_json_key_equals(key, key_length, "type")) {
+      const uint8_t* type;
+      uint32_t type_length;
+      if (cur.pos < length && data[cur.pos] == '"' && wsat_json_string(&cur, &type, &type_length)) {
+        wsat_event_header_type_set(header, type, type_length);
+        has_type = true;
+        is_parsed = true;
+      }
+    } else if (wsat_json_key_equals(key, key_length, "data_length")) {
+      is_parsed = wsat_json_uint(&cur, &header->data_length);
+    } else if (wsat_json_key_equals(key, key_length, "payload_length")) {
+      is_parsed = wsat_json_uint(&cur, &header->payload_length);
+    } else {
+      is_known = false;
+    }
+    if (!is_parsed) {
+      // Unknown field, or known field with unexpected value, which is skipped as any other value.
+      if (is_known) is_valid = false;
+      cur.pos = value_start;
+      if (!wsat_json_skip_value(&cur)) goto not_json;
+    }
+    wsat_json_skip_ws(&cur);
+    if (cur.pos >= length) goto not_json;
+    if (data[cur.pos] == '}') break;
+    if (data[cur.pos] != ',') goto not_json;
+    cur.pos++;
+  }
+  *end = cur.pos + 1;
+  return is_valid && has_type ? WSAT_EVENT_HEADER_TOKENIZE_OK : WSAT_EVENT_HEADER_TOKENIZE_INVALID;
+not_json:
+  *end = cur.pos < length ? cur.pos : length;
+  return WSAT_EVENT_HEADER_TOKENIZE_NOT_JSON;
+}
+
+static void wsat_reverse_bytes(uint8_t* data, uint32_t length)
+{
+  for (uint32_t i = 0, j = length - 1; i < j; i++, j--) {
+    const uint8_t tmp = data[i];
+    data[i] = data[j];
+    data[j] = tmp;
+  }
+}
+
+// Makes the unprocessed bytes contiguous, if they wrap around the end of the ring.
+static void wsat_event_decoder_linearize(struct wsat_event_decoder* dec)
+{
+  const uint32_t tail_length = EVENT_DECODER_BUFFER_SIZE - dec->read_pos;
+  if (dec->buffer_length <= tail_length) return;
+  const uint32_t head_length = dec->buffer_length - tail_length;
+  if (dec->buffer_length <= dec->read_pos) {
+    // There is enough free space between, so just shift head and put tail before it.
+    memmove(dec->buffer + tail_length, dec->buffer, head_length);
+    memcpy(dec->buffer, dec->buffer + dec->read_pos, tail_length);
+  } else {
+    // Ring is almost full, rotate it in place instead.
+    wsat_reverse_bytes(dec->buffer, EVENT_DECODER_BUFFER_SIZE);
+    wsat_reverse_bytes(dec->buffer, tail_length);
+    wsat_reverse_bytes(dec->buffer + tail_length, EVENT_DECODER_BUFFER_SIZE - tail_length);
+  }
+  dec->read_pos = 0;
+  dec->write_pos = dec->buffer_length % EVENT_DECODER_BUFFER_SIZE;
+}
+
+static int32_t wsat_event_decoder_output(struct wsat_event_decoder* dec, uint8_t flags,
+                                         struct wsat_decoded_event** out_event)
+{
+  dec->wip_evt.flags = flags;
+  *out_event = &dec->wip_evt;
+  if (flags & WSAT_DECODED_EVENT_FLAG_END) {
+    dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
+    dec->payload_received = 0;
+    // Spilled data are not needed after this event is handled, but they must stay in place until then.
+    dec->spill.length = 0;
+  }
+  return 1;
+}
+
+int32_t wsat_event_decoder_next(struct wsat_event_decoder* dec, struct wsat_decoded_event** out_event)
 {
   uint8_t flags = 0;
-  uint32_t processed_bytes = 0;
   bool ready_to_output_event = false;
-  while (processed_bytes < dec->buffer_length) {
-    uint8_t* buffer = dec->buffer + processed_bytes;
-    uint32_t buffer_length = dec->buffer_length - processed_bytes;
+  // Data span is valid only while the event begins, bytes behind it may be overwritten since now.
+  dec->wip_evt.data_span.json = NULL;
+  dec->wip_evt.data_span.length = 0;
+  if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER && dec->spill.length == 0) {
+    // Previous event is done, so allocated spill buffer isn't needed anymore.
+    wsat_event_decoder_spill_free(dec);
+  }
+  while (dec->buffer_length > 0) {
     struct wsat_event_header* header = &dec->wip_evt.header;
     if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER) {
+      uint8_t* header_start_pos;
+      uint32_t header_size;
+      // Header bigger than the ring is being collected in spill buffer
+      const bool is_spilled = dec->spill.length > 0;
+      if (is_spilled) {
+        const int32_t spill_res = wsat_event_decoder_spill_header(dec);
+        if (spill_res < 0) {
+          LOGE("Header doesn't fit even into spill buffer, looking for next header.");
+          dec->stats.spill_fail_count++;
+          wsat_event_decoder_resync(dec, 0);
+          continue;
+        }
+        if (spill_res == 0) continue;
+        header_start_pos = dec->spill.data;
+        header_size = dec->spill.length;
+        goto header_found;
+      }
+      // Header is parsed in place, so we look only at contiguous part of the ring.
+      // If the header isn't complete there, but the data wraps, they are linearized and searched again.
+      uint8_t* buffer = dec->buffer + dec->read_pos;
+      const uint32_t buffer_length = wsat_event_decoder_contiguous_length(dec);
+      const bool is_wrapped = buffer_length < dec->buffer_length;
       // Let's find start of the header `{"` anywhere in buffer
       if (buffer_length < 2) {
+        if (is_wrapped) goto linearize;
         return 0;
       }
-      uint8_t* header_start_pos = (uint8_t*)memmem(buffer, buffer_length, "{\"", 2);
+      header_start_pos = (uint8_t*)wsat_find_byte_pair(buffer, buffer_length, '{', '"');
       if (header_start_pos == NULL) {
+        if (is_wrapped) goto linearize;
+        // Nothing can start here, except `{` at the very end.
         if (buffer[buffer_length - 1] == '{') {
-          processed_bytes += buffer_length - 1;
+          wsat_event_decoder_drop(dec, buffer_length - 1);
           break;
         }
-        goto scratch_everything;
+        wsat_event_decoder_drop(dec, buffer_length);
+        break;
+      }
+      if (header_start_pos != buffer) {
+        // Skip junk, so the header starts at read position and its scan progress can be kept between calls.
+        wsat_event_decoder_drop(dec, header_start_pos - buffer);
+        continue;
       }
-      uint32_t header_start_offset = header_start_pos - buffer;
-      // Now find end of the header `}\n`
-      uint8_t* header_end_pos = (uint8_t*)memmem(header_start_pos,
-                                                 buffer_length - header_start_offset,
-                                                 "}\n", 2);
+      // Now find end of the header `}\n`, looking only at newly arrived bytes
+      uint8_t* header_end_pos = wsat_event_decoder_find_header_end(dec, header_start_pos, buffer_length);
       if (header_end_pos == NULL) {
+        if (is_wrapped) goto linearize;
         // We didn't find header, let's check if rest of data are not too much long for the limit.
-        const uint32_t current_header_size = buffer_length - header_start_offset;
-        if (current_header_size + 2 > EVENT_DECODER_BUFFER_SIZE) {
-          LOGD("Too big or invalid header, scratching the data.");
-          goto scratch_everything;
+        if (buffer_length + 2 > EVENT_DECODER_RING_CAPACITY) {
+          // Ring is full of the header, so continue collecting it in spill buffer, if there is one.
+          if (wsat_event_decoder_spill_append(dec, buffer, buffer_length)) {
+            dec->stats.spill_header_count++;
+            wsat_event_decoder_consume(dec, buffer_length);
+            continue;
+          }
+          // It's either not a header, or too big one. Look for next header start inside of it.
+          LOGD("Too big or invalid header, looking for next header.");
+          dec->stats.spill_fail_count++;
+          wsat_event_decoder_resync(dec, 1);
+          continue;
         }
-        // Remove unused data, if any
-        if (header_start_offset != 0) {
-          processed_bytes += header_start_offset;
-          break;
-        }
-        return 0;
+        break;
       }
       header_end_pos += 2; // So it marks real end of whole header
-      const uint32_t header_size = header_end_pos - header_start_pos;
-      const char* parse_end_ptr = NULL;
-      cJSON* header_json = cJSON_ParseWithLengthOpts((const char*)header_start_pos, header_size, &parse_end_ptr, false);
-      // If header wasn't found, or it's not real header we found, let's scrap where parser end
-      if (header_json == NULL || ((uint8_t*)parse_end_ptr + 1) != header_end_pos) {
+      header_size = header_end_pos - header_start_pos;
+header_found:
+      memset(&dec->wip_evt, 0, sizeof(struct wsat_decoded_event));
+      uint32_t tokenized_length = 0;
+      const enum wsat_event_header_tokenize_result tokenize_res = wsat_event_header_tokenize(
+        header_start_pos, header_size, header, &tokenized_length);
+      // It's not real header we found. Another one may start anywhere inside it, even before where tokenizer
+      // gave up (e.g. truncated header followed by whole one), so only the `{` is dropped.
+      if (tokenize_res == WSAT_EVENT_HEADER_TOKENIZE_NOT_JSON || tokenized_length + 1 != header_size) {
         LOGD("Failed to parse header");
-        uint32_t parsed_bytes = (uint8_t*)parse_end_ptr - header_start_pos;
-        if (parse_end_ptr == NULL) {
-          parsed_bytes = header_size;
+        if (is_spilled) {
+          // Bytes of spilled header are not in the ring anymore, so next header start is looked for in spill buffer
+          const uint8_t* next_start = wsat_find_byte_pair(dec->spill.data + 1, dec->spill.length - 1, '{', '"');
+          if (next_start != NULL) {
+            const uint32_t skipped = next_start - dec->spill.data;
+            dec->stats.resync_count++;
+            dec->stats.resync_skipped_bytes += skipped;
+            dec->spill.length -= skipped;
+            memmove(dec->spill.data, next_start, dec->spill.length);
+            header_size = dec->spill.length;
+            goto header_found;
+          }
         }
-        processed_bytes += header_start_offset + parsed_bytes;
-        if (header_json != NULL) cJSON_Delete(header_json);
+        wsat_event_decoder_resync(dec, is_spilled ? 0 : 1);
         continue;
       }
-      memset(&dec->wip_evt, 0, sizeof(struct wsat_decoded_event));
-      header->json = header_json;
-      cJSON* type_field = cJSON_GetObjectItem(header_json, "type");
-      if (type_field == NULL || !cJSON_IsString(type_field)) {
-        LOGD("Type is missing in header");
+      if (tokenize_res != WSAT_EVENT_HEADER_TOKENIZE_OK) {
+        LOGD("Type is missing in header or fields are invalid");
         goto scratch_header;
       }
-      header->type = cJSON_GetStringValue(type_field);
-      cJSON* data_length_field = cJSON_GetObjectItem(header_json, "data_length");
-      cJSON* payload_length_field = cJSON_GetObjectItem(header_json, "payload_length");
-      uint32_t data_length = 0, payload_length = 0;
-      if (data_length_field != NULL) {
-        data_length = (uint32_t)cJSON_GetNumberValue(data_length_field);
-        if (data_length > EVENT_DECODER_BUFFER_SIZE) {
-          LOGE("Data length is too big: %d", data_length);
-          goto scratch_header;
-        }
+      const uint32_t data_length = header->data_length, payload_length = header->payload_length;
+      if (data_length > EVENT_DECODER_RING_CAPACITY - (payload_length > 0 ? 1 : 0) &&
+          data_length > wsat_event_decoder_spill_max_size(dec)) {
+        LOGE("Data length is too big: %d", data_length);
+        dec->stats.spill_fail_count++;
+        goto scratch_header;
       }
-      if (payload_length_field != NULL) {
-        double payload_length_dbl = cJSON_GetNumberValue(payload_length_field);
-        if (payload_length_dbl < 0) goto scratch_header;
-        payload_length = (uint32_t)payload_length_dbl;
-        if (payload_length > 128 * 1024) {
-          LOGE("Payload length is too big: %d", payload_length);
-          goto scratch_header;
-        }
+      if (payload_length > EVENT_DECODER_PAYLOAD_MAX_LENGTH) {
+        LOGE("Payload length is too big: %d", payload_length);
+        goto scratch_header;
       }
-      header->data_length = data_length;
-      header->payload_length = payload_length;
-
-      cJSON* data_field = cJSON_GetObjectItem(header_json, "data");
-      if (data_field != NULL && cJSON_IsObject(data_field)) {
-        header->data = data_field;
+      // Only the fields were needed, so the header bytes are not kept.
+      if (is_spilled) {
+        dec->spill.length = 0;
+      } else {
+        wsat_event_decoder_consume(dec, header_size);
+      }
+      dec->wip_evt.packet_type = wsat_packet_type_get(header->type);
+      if (dec->skip_mask & WSAT_PACKET_TYPE_BIT(dec->wip_evt.packet_type)) {
+        // Nobody handles this type, so its data and payload are thrown away without looking at them.
+        LOGD("Skipping event \"%s\"", header->type);
+        dec->stats.skip_count++;
+        dec->skip_length = data_length + payload_length;
+        if (dec->skip_length > 0) dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_SKIP;
+        continue;
       }
-      processed_bytes += header_start_offset + header_size;
       flags |= WSAT_DECODED_EVENT_FLAG_BEGIN;
 
       if (data_length > 0) {
@@ -125,42 +668,69 @@ int32_t wsat_event_decoder_next(struct wsat_event_decoder* dec, struct wsat_deco
       }
       continue;
 scratch_header:
-      processed_bytes += header_start_offset + header_size;
-      cJSON_Delete(header_json);
+      if (is_spilled) {
+        dec->spill.length = 0;
+      } else {
+        wsat_event_decoder_consume(dec, header_size);
+      }
+      continue;
+linearize:
+      wsat_event_decoder_linearize(dec);
       continue;
     } else if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA) {
-      // Data must be JSON object, so scratch it if it doesn't start with `{`
-      if (buffer[0] != '{') {
+      // Data must be JSON object. If it's not, lengths in the header can't be trusted,
+      // so bytes which follow are scanned for next header instead.
+      if (dec->spill.length == 0 && dec->buffer[dec->read_pos] != '{') {
         LOGD("Data is not valid JSON Object");
-        goto scratch_everything;
+        wsat_event_decoder_resync(dec, 0);
+        continue;
       }
-      if (buffer_length < header->data_length) {
-        // We do not have all data bytes, let's wait for them.
-        if (processed_bytes != 0) {
+      uint8_t* buffer;
+      // Data is handed out only as span into the ring, which must stay valid until the event begins.
+      // If payload follows, wait also for its first byte, so the event begins in this same call.
+      const uint32_t needed_length = header->data_length + (header->payload_length > 0 ? 1 : 0);
+      if (needed_length > EVENT_DECODER_RING_CAPACITY) {
+        // Data block doesn't fit into the ring, so it's collected in spill buffer, where it stays until the event ends.
+        const uint32_t data_left = header->data_length - dec->spill.length;
+        const uint32_t contiguous_length = wsat_event_decoder_contiguous_length(dec);
+        const uint32_t length = data_left < contiguous_length ? data_left : contiguous_length;
+        if (dec->spill.length == 0) dec->stats.spill_data_count++;
+        if (!wsat_event_decoder_spill_append(dec, dec->buffer + dec->read_pos, length)) {
+          LOGE("Data doesn't fit into spill buffer, looking for next header.");
+          dec->stats.spill_fail_count++;
+          wsat_event_decoder_resync(dec, 0);
+          continue;
+        }
+        wsat_event_decoder_consume(dec, length);
+        if (dec->spill.length < header->data_length) continue;
+        if (header->payload_length > 0 && dec->buffer_length == 0) break;
+        buffer = dec->spill.data;
+        if (buffer[header->data_length - 1] != '}') {
+          LOGD("Data is not valid JSON Object");
+          wsat_event_decoder_resync(dec, 0);
+          continue;
+        }
+      } else {
+        if (dec->buffer_length < needed_length) {
+          // We do not have all data bytes, let's wait for them.
           break;
         }
-        return 0;
-      }
-      if (buffer[header->data_length - 1] != '}') {
-        LOGD("Data is not valid JSON Object");
-        goto scratch_everything;
-      }
-      const char* parse_end_ptr = NULL;
-      cJSON* data_json = cJSON_ParseWithLengthOpts((const char*)buffer, header->data_length, &parse_end_ptr, false);
-      // If data couldn't be parsed, or wasn't parsed til end, let's scrap this.
-      if (data_json == NULL || ((uint8_t*)parse_end_ptr) != buffer + header->data_length) {
-        LOGD("Failed to parse data");
-        uint32_t parsed_bytes = (uint8_t*)parse_end_ptr - buffer;
-        if (parse_end_ptr == NULL) {
-          parsed_bytes = header->data_length;
+        // Data is parsed in place, so it must be contiguous.
+        if (wsat_event_decoder_contiguous_length(dec) < header->data_length) {
+          wsat_event_decoder_linearize(dec);
         }
-        processed_bytes += parsed_bytes;
-        if (data_json != NULL) cJSON_Delete(data_json);
-        dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
-        continue;
+        buffer = dec->buffer + dec->read_pos;
+        if (buffer[header->data_length - 1] != '}') {
+          // Only the `{` is dropped, next header may be anywhere in the bytes.
+          LOGD("Data is not valid JSON Object");
+          wsat_event_decoder_resync(dec, 1);
+          continue;
+        }
+        wsat_event_decoder_consume(dec, header->data_length);
       }
-      dec->wip_evt.data = data_json;
-      processed_bytes += header->data_length;
+      // Parsing is left to wsat_decoded_event_get_data, as most handlers never look at the data.
+      dec->wip_evt.data_span.json = (const char*)buffer;
+      dec->wip_evt.data_span.length = header->data_length;
       flags |= WSAT_DECODED_EVENT_FLAG_BEGIN;
       if (header->payload_length > 0) {
         dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD;
@@ -169,19 +739,27 @@ scratch_header:
         ready_to_output_event = true;
         break;
       }
+    } else if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_SKIP) {
+      const uint32_t length = dec->skip_length < dec->buffer_length ? dec->skip_length : dec->buffer_length;
+      wsat_event_decoder_consume(dec, length);
+      dec->skip_length -= length;
+      if (dec->skip_length == 0) dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
     } else if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD) {
       struct wsat_event_payload_chunk* payload = &dec->wip_evt.payload;
-      uint32_t payload_size_left = header->payload_length - dec->payload_received;
-      uint32_t size = payload_size_left < buffer_length ? payload_size_left : buffer_length;
-      // TODO: We can avoid having payload_buffer variable, if memcpy below will handle this.
-      memcpy(dec->payload_buffer, buffer, size);
-      payload->data = dec->payload_buffer;
+      if (dec->payload_received == 0) wsat_event_decoder_payload_align(dec);
+      const uint32_t payload_size_left = header->payload_length - dec->payload_received;
+      const uint32_t contiguous_length = wsat_event_decoder_contiguous_length(dec);
+      // Chunk never wraps, rest of the payload after end of the ring is handed out as next chunk.
+      const uint32_t size = payload_size_left < contiguous_length ? payload_size_left : contiguous_length;
+      // Chunk is handed out as read-only view into the ring, valid until next call of
+      // wsat_event_decoder_next or wsat_event_decoder_buffer_get.
+      payload->data = dec->buffer + dec->read_pos;
       payload->size = size;
       payload->offset = dec->payload_received;
       if (dec->payload_received == 0) flags |= WSAT_DECODED_EVENT_FLAG_BEGIN;
       flags |= WSAT_DECODED_EVENT_FLAG_PAYLOAD;
       dec->payload_received += size;
-      processed_bytes += size;
+      wsat_event_decoder_consume(dec, size);
       ready_to_output_event = true;
       if (dec->payload_received == header->payload_length) {
         flags |= WSAT_DECODED_EVENT_FLAG_END;
@@ -190,27 +768,37 @@ scratch_header:
     }
   }
 
-  if (processed_bytes < dec->buffer_length) {
-    memcpy(dec->buffer, dec->buffer + processed_bytes, dec->buffer_length - processed_bytes);
-  }
-  dec->buffer_length = dec->buffer_length - processed_bytes;
   if (!ready_to_output_event) return 0;
 
-  dec->wip_evt.flags = flags;
-  *out_event = dec->wip_evt;
-  if (flags & WSAT_DECODED_EVENT_FLAG_END) {
-    dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
-    dec->payload_received = 0;
-  }
+  return wsat_event_decoder_output(dec, flags, out_event);
+}
 
-  return 1;
-scratch_everything:
-  if (dec->state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA) {
-    cJSON_Delete(dec->wip_evt.header.json);
+uint32_t wsat_event_decoder_payload_direct_length(struct wsat_event_decoder* dec)
+{
+  // Payload bytes can go elsewhere only if nothing before them waits in the ring.
+  if (dec->state != WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD || dec->buffer_length > 0) return 0;
+  return dec->wip_evt.header.payload_length - dec->payload_received;
+}
+
+int32_t wsat_event_decoder_payload_direct(struct wsat_event_decoder* dec, uint8_t* data, uint32_t length,
+                                          struct wsat_decoded_event** out_event)
+{
+  const uint32_t direct_length = wsat_event_decoder_payload_direct_length(dec);
+  if (length == 0 || length > direct_length) {
+    LOGE("Direct payload of %d bytes, but only %d are expected", length, direct_length);
+    return 0;
   }
-  dec->buffer_length = 0;
-  dec->state = WSAT_EVENT_DECODER_PROCESS_STATE_HEADER;
-  return 0;
+  uint8_t flags = WSAT_DECODED_EVENT_FLAG_PAYLOAD | WSAT_DECODED_EVENT_FLAG_PAYLOAD_LENT;
+  struct wsat_event_payload_chunk* payload = &dec->wip_evt.payload;
+  dec->wip_evt.data_span.json = NULL;
+  dec->wip_evt.data_span.length = 0;
+  payload->data = data;
+  payload->size = length;
+  payload->offset = dec->payload_received;
+  if (dec->payload_received == 0) flags |= WSAT_DECODED_EVENT_FLAG_BEGIN;
+  dec->payload_received += length;
+  if (dec->payload_received == dec->wip_evt.header.payload_length) flags |= WSAT_DECODED_EVENT_FLAG_END;
+  return wsat_event_decoder_output(dec, flags, out_event);
 }
 
 void wsat_decoded_event_free(struct wsat_decoded_event* evt)
@@ -219,397 +807,26 @@ void wsat_decoded_event_free(struct wsat_decoded_event* evt)
     // Do nothing.
     return;
   }
-  if (evt->header.data_length != 0) {
+  if (evt->data != NULL) {
     cJSON_Delete(evt->data);
   }
-  cJSON_Delete(evt->header.json);
   memset(evt, 0, sizeof(*evt));
 }
 
-// Temporary workaround for simple testing
-
-#if 0
-
-#include <assert.h>
-
-void test_wsat_decoder()
-{
-  int32_t res = 0;
-  struct wsat_decoded_event evt;
-  struct wsat_event_decoder dec;
-  uint8_t* buffer;
-  uint32_t capacity;
-#define MEMCPY_BUFFER(SRC, SIZE) { \
-capacity = wsat_event_decoder_buffer_get(&dec, &buffer); \
-if (capacity < SIZE) LOGD("TEST: cap %d < size %d", capacity, SIZE); \
-memcpy(buffer, SRC, capacity < SIZE ? capacity : SIZE); \
-wsat_event_decoder_buffer_advance(&dec, capacity < SIZE ? capacity : SIZE); }
-  if (1){
-    // Test initial partial header with junk on start
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "zxzzc{\"type\":\"test_wsat_decoder\"";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 27);
-    assert(dec.buffer[0] == '{');
-    // Now add rest + some junk on the end
-    const char* p2 = ",\"something\": true}\nabcdefghi";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "test_wsat_decoder") == 0);
-    assert(dec.buffer_length == 9);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Test too big header at once
-    wsat_event_decoder_reset(&dec);
-    const char p1[EVENT_DECODER_BUFFER_SIZE] = "{\"type\":\"test_wsat_decoder\"";
-    MEMCPY_BUFFER(p1, sizeof(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 0);
-    // Too big header in two steps
-    wsat_event_decoder_reset(&dec);
-    MEMCPY_BUFFER(p1, 45);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 45);
-    MEMCPY_BUFFER(p1, EVENT_DECODER_BUFFER_SIZE);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Test two JSONs between
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "zzzz{\"type\":\"fake\"}{\"type\":\"real\"}\n";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(dec.buffer_length == 0);
-    assert(strcmp(evt.header.type, "real") == 0);
-    wsat_decoded_event_free(&evt);
-    // Test look-a-like JSON and real JSON
-    wsat_event_decoder_reset(&dec);
-    const char* p2 = "zzzzz{\"wannabejson\"}{\"type\":\"real\"}\n";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(dec.buffer_length == 0);
-    assert(strcmp(evt.header.type, "real") == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Data test
-    wsat_event_decoder_reset(&dec);
-    dec.state = WSAT_EVENT_DECODER_PROCESS_STATE_DATA;
-    dec.wip_evt.header.data_length = 10;
-    const char* p1 = "{\"z\":";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 5);
-    const char* p2 = "1337}";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(dec.buffer_length == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Full packet test with segmentation variation 1
-    uint8_t payload[5056];
-    for (int i = 0; i < sizeof(payload); i++) payload[i] = i % 256 + i / 256;
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":\"test\",";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    // assert(dec.buffer_length == strlen(p1));
-    const char* p2 = "\"data_length\":18,\"payload_length\":5056}\n";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA);
-    // assert(dec.buffer_length == strlen(p1));
-    const char* p3 = "{\"somethi";
-    MEMCPY_BUFFER(p3, strlen(p3));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA);
-    const char* p4 = "ng\":true}";
-    MEMCPY_BUFFER(p4, strlen(p4));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD);
-    uint8_t payload_output[5056];
-    MEMCPY_BUFFER(payload, EVENT_DECODER_BUFFER_SIZE);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD);
-    assert(dec.buffer_length == 0);
-    assert(dec.payload_received == 4096);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
-    assert(evt.payload.offset == 0);
-    assert(evt.payload.size == 4096);
-    assert(evt.payload.data[2] == payload[2]);
-    memcpy(payload_output + evt.payload.offset, evt.payload.data, evt.payload.size);
-    MEMCPY_BUFFER(payload + EVENT_DECODER_BUFFER_SIZE, sizeof(payload) - EVENT_DECODER_BUFFER_SIZE);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_END | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
-    assert(evt.payload.offset == 4096);
-    assert(evt.payload.size == 960);
-    assert(dec.payload_received == 0);
-    assert(dec.buffer_length == 0);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER);
-    memcpy(payload_output + evt.payload.offset, evt.payload.data, evt.payload.size);
-    wsat_decoded_event_free(&evt);
-    for (int i = 0; i < sizeof(payload); i++) assert(payload[i] == payload_output[i]);
-  }
-  if (1){
-    // Simple header-only event in single chunk
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":\"simple\"}\n";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "simple") == 0);
-    assert(dec.buffer_length == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Two headers back-to-back in one buffer
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":\"first\"}\n{\"type\":\"second\"}\n";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "first") == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length > 0);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "second") == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Junk + partial header, then completion
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "junk{\"type\":\"par";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == strlen("{\"type\":\"par"));
-    assert(memcmp(dec.buffer, "{\"type\":\"par", dec.buffer_length) == 0);
-    const char* p2 = "tial\"}\n";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "partial") == 0);
-    assert(dec.buffer_length == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Header + data in one buffer
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":\"data-only\",\"data_length\":10}\n{\"x\":1234}";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "data-only") == 0);
-    cJSON* x = cJSON_GetObjectItem(evt.data, "x");
-    assert(x != NULL && cJSON_IsNumber(x));
-    assert((int)cJSON_GetNumberValue(x) == 1234);
-    assert(dec.buffer_length == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1){
-    // Data split across chunks with next header preserved
-    wsat_event_decoder_reset(&dec);
-    const char* h1 = "{\"type\":\"data-chunk\",\"data_length\":12}\n";
-    const char* d1 = "{\"foo\":";
-    const char* d2 = "true}";
-    const char* h2 = "{\"type\":\"next\"}\n";
-    MEMCPY_BUFFER(h1, strlen(h1));
-    MEMCPY_BUFFER(d1, strlen(d1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    MEMCPY_BUFFER(d2, strlen(d2));
-    MEMCPY_BUFFER(h2, strlen(h2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "data-chunk") == 0);
-    cJSON* foo = cJSON_GetObjectItem(evt.data, "foo");
-    assert(foo != NULL && cJSON_IsBool(foo) && cJSON_IsTrue(foo));
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == strlen(h2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "next") == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Header + payload in one buffer
-    uint8_t payload[4] = {1, 2, 3, 4};
-    wsat_event_decoder_reset(&dec);
-    const char* h1 = "{\"type\":\"payload-one\",\"payload_length\":4}\n";
-    MEMCPY_BUFFER(h1, strlen(h1));
-    MEMCPY_BUFFER(payload, sizeof(payload));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
-                         WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "payload-one") == 0);
-    assert(evt.payload.offset == 0);
-    assert(evt.payload.size == sizeof(payload));
-    assert(memcmp(evt.payload.data, payload, sizeof(payload)) == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Payload split into multiple chunks
-    uint8_t payload[9] = {10, 11, 12, 13, 14, 15, 16, 17, 18};
-    wsat_event_decoder_reset(&dec);
-    const char* h1 = "{\"type\":\"payload-chunks\",\"payload_length\":9}\n";
-    MEMCPY_BUFFER(h1, strlen(h1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    MEMCPY_BUFFER(payload, 2);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
-    assert(evt.payload.offset == 0);
-    assert(evt.payload.size == 2);
-    assert(memcmp(evt.payload.data, payload, 2) == 0);
-    MEMCPY_BUFFER(payload + 2, 3);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == WSAT_DECODED_EVENT_FLAG_PAYLOAD);
-    assert(evt.payload.offset == 2);
-    assert(evt.payload.size == 3);
-    assert(memcmp(evt.payload.data, payload + 2, 3) == 0);
-    MEMCPY_BUFFER(payload + 5, 4);
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_PAYLOAD | WSAT_DECODED_EVENT_FLAG_END));
-    assert(evt.payload.offset == 5);
-    assert(evt.payload.size == 4);
-    assert(memcmp(evt.payload.data, payload + 5, 4) == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER);
-  }
-  if (1){
-    // Skip invalid header and parse the next one
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":123}\n{\"type\":\"good\"}\n";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "good") == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Data length too big should discard header
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{\"type\":\"big-data\",\"data_length\":4097}\n";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Header + data + payload in one buffer
-    uint8_t payload[4] = {21, 22, 23, 24};
-    wsat_event_decoder_reset(&dec);
-    const char* h1 = "{\"type\":\"data-payload\",\"data_length\":7,\"payload_length\":4}\n";
-    const char* data = "{\"a\":1}";
-    MEMCPY_BUFFER(h1, strlen(h1));
-    MEMCPY_BUFFER(data, strlen(data));
-    MEMCPY_BUFFER(payload, sizeof(payload));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
-                         WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "data-payload") == 0);
-    cJSON* a = cJSON_GetObjectItem(evt.data, "a");
-    assert(a != NULL && cJSON_IsNumber(a));
-    assert((int)cJSON_GetNumberValue(a) == 1);
-    assert(evt.payload.offset == 0);
-    assert(evt.payload.size == sizeof(payload));
-    assert(memcmp(evt.payload.data, payload, sizeof(payload)) == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Known bug: payload chunk data should remain valid when next header follows
-    uint8_t payload[3] = {'a', 'b', 'c'};
-    wsat_event_decoder_reset(&dec);
-    const char* h1 = "{\"type\":\"payload-next\",\"payload_length\":3}\n";
-    const char* h2 = "{\"type\":\"after\",\"very_long\":\"aaaaaaaaaaaaaaaaaaaaaaaa\"}\n";
-    MEMCPY_BUFFER(h1, strlen(h1));
-    MEMCPY_BUFFER(payload, sizeof(payload));
-    MEMCPY_BUFFER(h2, strlen(h2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(evt.flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
-                         WSAT_DECODED_EVENT_FLAG_END));
-    assert(strcmp(evt.header.type, "payload-next") == 0);
-    assert(memcmp(evt.payload.data, payload, sizeof(payload)) == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == strlen(h2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "after") == 0);
-    wsat_decoded_event_free(&evt);
-    assert(dec.buffer_length == 0);
-  }
-  if (1){
-    // Header start split across chunks should be handled
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "{";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    const char* p2 = "\"type\":\"split\"}\n";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "split") == 0);
-    wsat_decoded_event_free(&evt);
-  }
-  if (1) {
-    // Header starts one byte before with junk on start
-    wsat_event_decoder_reset(&dec);
-    const char* p1 = "junk{";
-    MEMCPY_BUFFER(p1, strlen(p1));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 0);
-    assert(dec.buffer_length == 1);
-    const char* p2 = "\"type\":\"test\"}\n";
-    MEMCPY_BUFFER(p2, strlen(p2));
-    res = wsat_event_decoder_next(&dec, &evt);
-    assert(res == 1);
-    assert(strcmp(evt.header.type, "test") == 0);
-    wsat_decoded_event_free(&evt);
+cJSON* wsat_decoded_event_get_data(struct wsat_decoded_event* evt)
+{
+  if (evt->data != NULL || evt->data_span.json == NULL) return evt->data;
+  const char* parse_end_ptr = NULL;
+  cJSON* data_json = cJSON_ParseWithLengthOpts(evt->data_span.json, evt->data_span.length, &parse_end_ptr, false);
+  // If data couldn't be parsed, or wasn't parsed til end, handler gets no data.
+  if (data_json == NULL || parse_end_ptr != evt->data_span.json + evt->data_span.length) {
+    LOGD("Failed to parse data");
+    if (data_json != NULL) cJSON_Delete(data_json);
+    data_json = NULL;
   }
+  // Parse is attempted only once, result is kept until the event ends.
+  evt->data = data_json;
+  evt->data_span.json = NULL;
+  evt->data_span.length = 0;
+  return evt->data;
 }
-
-#endif
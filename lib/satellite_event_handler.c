@@ -2,9 +2,8 @@
 // SPDX-License-Identifier: Apache-2.0
 
 /**
- * Event handling is made by defining list of packet types,
- * which will be handled. Right now, we compare packet types just with strcmp.
- * Although, at some point it might be beneficial to calculate hash of the types, and compare that.
+ * Event handling is made by defining table of handlers indexed by packet type,
+ * which is already resolved by decoder. Every mode can supply its own table, which is used on top of the default one.
  */
 
 #include <stdlib.h>
@@ -12,120 +11,112 @@
 
 #include "satellite_priv.h"
 
-struct packet_type_map_entry
+static const char* wsat_info_string(const char* value, const char* fallback)
 {
-  const char* type_str;
-  enum wsat_packet_type type_enum;
-} static const packet_type_map[] = {
-  { "describe",        WSAT_EVENT_TYPE_DESCRIBE },
-  { "ping",            WSAT_EVENT_TYPE_PING },
-  { "run-satellite",   WSAT_EVENT_TYPE_RUN_SATELLITE },
-  { "pause-satellite", WSAT_EVENT_TYPE_PAUSE_SATELLITE },
-  { "audio-start",     WSAT_EVENT_TYPE_AUDIO_START },
-  { "audio-chunk",     WSAT_EVENT_TYPE_AUDIO_CHUNK },
-  { "audio-stop",      WSAT_EVENT_TYPE_AUDIO_STOP },
-  { "detection",       WSAT_EVENT_TYPE_DETECTION },
-  { "voice-stopped",   WSAT_EVENT_TYPE_VOICE_STOPPED },
-  { "error",           WSAT_EVENT_TYPE_ERROR },
-  { "transcript",      WSAT_EVENT_TYPE_TRANSCRIPT},
-};
+  return value != NULL ? value : fallback;
+}
+
+static void wsat_info_attribution_write(struct wsat_json_writer* writer, const char* name, const char* url)
+{
+  wsat_json_writer_object_begin(writer, "attribution");
+  wsat_json_writer_string(writer, "name", name);
+  wsat_json_writer_string(writer, "url", url);
+  wsat_json_writer_object_end(writer);
+}
+
+static void wsat_info_wake_write(struct wsat_json_writer* writer, const struct wsat_wake* wake)
+{
+  wsat_json_writer_object_begin(writer, NULL);
+  wsat_json_writer_string(writer, "name", wsat_info_string(wake->engine_name, "microwakeword-c"));
+  wsat_info_attribution_write(writer, "gamelaster", "-");
+  wsat_json_writer_bool(writer, "installed", true);
+  wsat_json_writer_string(writer, "description",
+                          wsat_info_string(wake->engine_description, "C compatible implementation of MicroWakeWord"));
+  wsat_json_writer_string(writer, "version", wsat_info_string(wake->engine_version, "1.0.0"));
+  wsat_json_writer_array_begin(writer, "models");
+  wsat_json_writer_object_begin(writer, NULL);
+  wsat_json_writer_string(writer, "name", wake->name);
+  wsat_info_attribution_write(writer, wsat_info_string(wake->model_attribution_name, "-"),
+                              wsat_info_string(wake->model_attribution_url, "-"));
+  wsat_json_writer_bool(writer, "installed", true);
+  wsat_json_writer_string(writer, "description", wsat_info_string(wake->model_description, "Wake word model"));
+  wsat_json_writer_string(writer, "version", wsat_info_string(wake->model_version, "1.0.0"));
+  wsat_json_writer_array_begin(writer, "languages");
+  if (wake->languages != NULL) {
+    for (const char* const* language = wake->languages; *language != NULL; language++) {
+      wsat_json_writer_string(writer, NULL, *language);
+    }
+  }
+  wsat_json_writer_array_end(writer);
+  wsat_json_writer_string(writer, "phrase", wsat_info_string(wake->phrase, wake->name));
+  wsat_json_writer_object_end(writer);
+  wsat_json_writer_array_end(writer);
+  wsat_json_writer_object_end(writer);
+}
 
+// Info depends only on components, so wsat_run renders it for the ones it runs with, and describe just sends it.
+void wsat_info_render()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_json_writer writer;
+  PLAT_MUTEX_LOCK(&inst->server.send_mutex); // Cached data might be being sent right now
+  wsat_json_writer_init(&writer, inst->info_data, sizeof(inst->info_data));
+  wsat_json_writer_object_begin(&writer, NULL);
+  wsat_json_writer_array_begin(&writer, "asr");
+  wsat_json_writer_array_end(&writer);
+  wsat_json_writer_array_begin(&writer, "tts");
+  wsat_json_writer_array_end(&writer);
+  wsat_json_writer_array_begin(&writer, "handle");
+  wsat_json_writer_array_end(&writer);
+  wsat_json_writer_array_begin(&writer, "intent");
+  wsat_json_writer_array_end(&writer);
+  wsat_json_writer_array_begin(&writer, "wake");
+  if (inst->wake != NULL) wsat_info_wake_write(&writer, inst->wake);
+  wsat_json_writer_array_end(&writer);
+  wsat_json_writer_object_begin(&writer, "satellite");
+  wsat_json_writer_string(&writer, "name", "Wyoming C Satellite");
+  wsat_info_attribution_write(&writer, "", "");
+  wsat_json_writer_bool(&writer, "installed", true);
+  wsat_json_writer_string(&writer, "description", "my satellite");
+  wsat_json_writer_string(&writer, "version", "1.0.0");
+  wsat_json_writer_null(&writer, "area");
+  wsat_json_writer_null(&writer, "snd_format");
+  wsat_json_writer_object_end(&writer);
+  wsat_json_writer_object_end(&writer);
+  if (writer.is_overflow) {
+    LOGE("Info doesn't fit into %d bytes, describe won't be answered", WSAT_INFO_DATA_SIZE);
+    writer.length = 0;
+  }
+  inst->info_data_length = writer.length;
+  PLAT_MUTEX_UNLOCK(&inst->server.send_mutex);
+}
 
 static int32_t handle_describe(struct wsat_decoded_event* evt)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
-  cJSON* header = cJSON_CreateObject();
-  cJSON_AddStringToObject(header, "type", "info");
-  cJSON_AddStringToObject(header, "version", "1.5.2");
-  cJSON* data = cJSON_CreateObject();
-  cJSON* asr_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "asr", asr_array);
-  cJSON* tts_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "tts", tts_array);
-  cJSON* handle_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "handle", handle_array);
-  cJSON* intent_array = cJSON_CreateArray();
-  cJSON_AddItemToObject(data, "intent", intent_array);
-  cJSON* wake_array = cJSON_CreateArray();
-
-  if (inst->wake != NULL) {
-    // TODO: Get more information from wake component
-    cJSON* wake_entry = cJSON_CreateObject();
-
-    cJSON_AddStringToObject(wake_entry, "name", "microwakeword-c");
-    cJSON* w0_attr = cJSON_CreateObject();
-    cJSON_AddItemToObject(wake_entry, "attribution", w0_attr);
-    cJSON_AddStringToObject(w0_attr, "name", "gamelaster");
-    cJSON_AddStringToObject(w0_attr, "url", "-");
-    cJSON_AddBoolToObject(wake_entry, "installed", 1);
-    cJSON_AddStringToObject(wake_entry, "description",
-                            "C compatible implementation of MicroWakeWord");
-    cJSON_AddStringToObject(wake_entry, "version", "1.0.0");
-
-    cJSON* models = cJSON_CreateArray();
-    cJSON_AddItemToObject(wake_entry, "models", models);
-
-    cJSON* model = cJSON_CreateObject();
-    cJSON_AddItemToArray(models, model);
-    cJSON_AddStringToObject(model, "name", inst->wake->name);
-    cJSON* m_attr = cJSON_CreateObject();
-    cJSON_AddItemToObject(model, "attribution", m_attr);
-    cJSON_AddStringToObject(m_attr, "name", "-");
-    cJSON_AddStringToObject(m_attr, "url", "-");
-    cJSON_AddBoolToObject(model, "installed", 1);
-    cJSON_AddStringToObject(model, "description", "Wake word model");
-    cJSON_AddStringToObject(model, "version", "1.0.0");
-    cJSON* langs = cJSON_CreateArray();
-    cJSON_AddItemToObject(model, "languages", langs);
-    cJSON_AddStringToObject(model, "phrase", inst->wake->name);
-
-    cJSON_AddItemToArray(wake_array, wake_entry);
+  if (!wsat_event_batch_begin(WSAT_SEND_CLASS_CONTROL)) return 0;
+  if (inst->info_data_length > 0) {
+    static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("info", "1.5.2");
+    wsat_event_batch_write_data(header, sizeof(header) - 1, inst->info_data, inst->info_data_length);
   }
-  cJSON_AddItemToObject(data, "wake", wake_array);
-
-  cJSON* satellite_obj = cJSON_CreateObject();
-  cJSON_AddStringToObject(satellite_obj, "name", "Wyoming C Satellite");
-  cJSON* attribution_obj = cJSON_CreateObject();
-  cJSON_AddStringToObject(attribution_obj, "name", "");
-  cJSON_AddStringToObject(attribution_obj, "url", "");
-  cJSON_AddItemToObject(satellite_obj, "attribution", attribution_obj);
-  cJSON_AddTrueToObject(satellite_obj, "installed");
-  cJSON_AddStringToObject(satellite_obj, "description", "my satellite");
-  cJSON_AddStringToObject(satellite_obj, "version", "1.0.0");
-  cJSON_AddNullToObject(satellite_obj, "area");
-  cJSON_AddNullToObject(satellite_obj, "snd_format");
-  cJSON_AddItemToObject(data, "satellite", satellite_obj);
-
-  struct wsat_event res_evt = {
-    .header = header,
-    .data = data
-  };
-  wsat_event_send(&res_evt);
-  wsat_event_free(&res_evt, true);
+  wsat_event_batch_end();
   return 0;
 }
 
 int32_t handle_ping(struct wsat_decoded_event* evt)
 {
-  struct wsat_inst_priv* inst = &wsat_priv;
-
-  cJSON* header = cJSON_CreateObject();
-  cJSON_AddStringToObject(header, "type", "pong");
-  cJSON_AddStringToObject(header, "version", "1.7.2");
-
-  cJSON* data = NULL;
-  if (evt->data != NULL) {
-    data = cJSON_CreateObject();
-    char* text = cJSON_GetStringValue(cJSON_GetObjectItem(evt->data, "text"));
-    cJSON_AddStringToObject(data, "text", text);
+  wsat_server_ping_received();
+  cJSON* req_data = wsat_decoded_event_get_data(evt);
+  struct wsat_json_writer* data = wsat_event_write_begin(WSAT_SEND_CLASS_CONTROL);
+  if (data == NULL) return 0;
+  if (req_data != NULL) {
+    wsat_json_writer_object_begin(data, NULL);
+    char* text = cJSON_GetStringValue(cJSON_GetObjectItem(req_data, "text"));
+    if (text != NULL) wsat_json_writer_string(data, "text", text);
+    wsat_json_writer_object_end(data);
   }
-
-  struct wsat_event res_pkt = {
-    .header = header,
-    .data = data
-  };
-  wsat_event_send(&res_pkt);
-  wsat_event_free(&res_pkt, false);
+  static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("pong", "1.7.2");
+  wsat_event_write_end(header, sizeof(header) - 1, NULL, 0);
   return 0;
 }
 
@@ -133,11 +124,13 @@ static int32_t handle_audio_start(struct wsat_decoded_event* evt)
 {
   // TODO: Maybe tell to SND more information about the length of incoming data.
   struct wsat_inst_priv* inst = &wsat_priv;
-  if (evt->data != NULL && inst->snd != NULL) {
+  if (inst->snd == NULL) return 0;
+  cJSON* data = wsat_decoded_event_get_data(evt);
+  if (data != NULL) {
     struct wsat_sys_event_audio_start_params params;
-    params.rate = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(evt->data, "rate"));
-    params.width = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(evt->data, "width"));
-    params.channels = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(evt->data, "channels"));
+    params.rate = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(data, "rate"));
+    params.width = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(data, "width"));
+    params.channels = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(data, "channels"));
     inst->snd->comp.sys_event_handle_fn(WSAT_SYS_EVENT_SND_AUDIO_START, &params);
   }
   return 0;
@@ -147,6 +140,11 @@ static int32_t handle_audio_chunk(struct wsat_decoded_event* evt)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   if (inst->snd != NULL) {
+    if (evt->flags & WSAT_DECODED_EVENT_FLAG_PAYLOAD_LENT) {
+      // Audio is already in sound component memory
+      inst->snd->buffer_commit_fn(evt->payload.data, evt->payload.size);
+      return 0;
+    }
     struct wsat_sys_event_buffer_params params;
     params.data = evt->payload.data;
     params.size = evt->payload.size;
@@ -168,72 +166,73 @@ static int32_t handle_error(struct wsat_decoded_event* evt)
 {
   char* error_str = NULL;
   char* error_code = NULL;
-  if (evt->data != NULL) {
-    error_str = cJSON_GetStringValue(cJSON_GetObjectItem(evt->data, "text"));
-    error_code = cJSON_GetStringValue(cJSON_GetObjectItem(evt->data, "code"));
+  cJSON* data = wsat_decoded_event_get_data(evt);
+  if (data != NULL) {
+    error_str = cJSON_GetStringValue(cJSON_GetObjectItem(data, "text"));
+    error_code = cJSON_GetStringValue(cJSON_GetObjectItem(data, "code"));
   }
   LOGE("Satellite returned error: \"%s\" (%s)", error_str != NULL ? error_str : "-",
     error_code != NULL ? error_code : "-");
   return 0;
 }
 
-struct packet_handler
-{
-  enum wsat_packet_type type;
-  int32_t (* handler_fn)(struct wsat_decoded_event*);
-} static packet_handlers[] = {
-  { WSAT_EVENT_TYPE_DESCRIBE,      handle_describe },
-  { WSAT_EVENT_TYPE_PING,          handle_ping },
-  { WSAT_EVENT_TYPE_AUDIO_START,   handle_audio_start },
-  { WSAT_EVENT_TYPE_AUDIO_CHUNK,   handle_audio_chunk },
-  { WSAT_EVENT_TYPE_AUDIO_STOP,    handle_audio_stop },
-  { WSAT_EVENT_TYPE_ERROR,         handle_error },
-  // { WSAT_EVENT_TYPE_DETECTION,     handle_detection },
-  // { WSAT_EVENT_TYPE_VOICE_STOPPED, handle_voice_stopped }
+const wsat_event_handler_fn wsat_event_default_handlers[WSAT_EVENT_TYPE_COUNT] = {
+  [WSAT_EVENT_TYPE_DESCRIBE] =      handle_describe,
+  [WSAT_EVENT_TYPE_PING] =          handle_ping,
+  [WSAT_EVENT_TYPE_AUDIO_START] =   handle_audio_start,
+  [WSAT_EVENT_TYPE_AUDIO_CHUNK] =   handle_audio_chunk,
+  [WSAT_EVENT_TYPE_AUDIO_STOP] =    handle_audio_stop,
+  [WSAT_EVENT_TYPE_ERROR] =         handle_error,
+  // [WSAT_EVENT_TYPE_DETECTION] =     handle_detection,
+  // [WSAT_EVENT_TYPE_VOICE_STOPPED] = handle_voice_stopped,
 };
 
-int32_t wsat_event_handle_default(enum wsat_packet_type packet_type, struct wsat_decoded_event* evt)
+uint32_t wsat_event_interest_mask_get()
 {
-  uint8_t handlers_count = sizeof(packet_handlers) / sizeof(struct packet_handler);
-  for (uint8_t i = 0; i < handlers_count; i++) {
-    if (packet_type == packet_handlers[i].type) {
-      packet_handlers[i].handler_fn(evt);
-      return 1;
+  struct wsat_inst_priv* inst = &wsat_priv;
+  uint32_t default_mask = 0, mode_mask = 0;
+  for (uint8_t type = 0; type < WSAT_EVENT_TYPE_COUNT; type++) {
+    if (wsat_event_default_handlers[type] != NULL) default_mask |= WSAT_PACKET_TYPE_BIT(type);
+    if (inst->mode != NULL && inst->mode->event_handlers != NULL && inst->mode->event_handlers[type] != NULL) {
+      mode_mask |= WSAT_PACKET_TYPE_BIT(type);
     }
   }
-  return 0;
+  if (inst->snd == NULL) {
+    // Without speaker, there is nothing to do with TTS audio
+    default_mask &= ~(WSAT_PACKET_TYPE_BIT(WSAT_EVENT_TYPE_AUDIO_START) |
+                      WSAT_PACKET_TYPE_BIT(WSAT_EVENT_TYPE_AUDIO_CHUNK) |
+                      WSAT_PACKET_TYPE_BIT(WSAT_EVENT_TYPE_AUDIO_STOP));
+  }
+  return default_mask | mode_mask;
 }
 
-void wsat_event_handle(struct wsat_decoded_event* evt)
+// Payload of audio chunk goes only to sound component, so it can be read straight into its buffer, if it lends one.
+uint32_t wsat_event_payload_lend(struct wsat_decoded_event* evt, uint8_t** buffer)
 {
-  int32_t res = 0;
   struct wsat_inst_priv* inst = &wsat_priv;
-  const static uint8_t packet_type_entries = sizeof(packet_type_map) / sizeof(struct packet_type_map_entry);
-
-  enum wsat_packet_type packet_type = WSAT_EVENT_TYPE_NONE;
-  for (uint8_t i = 0; i < packet_type_entries; i++) {
-    if (strcmp(evt->header.type, packet_type_map[i].type_str) == 0) {
-      packet_type = packet_type_map[i].type_enum;
-      break;
-    }
+  if (evt->packet_type != WSAT_EVENT_TYPE_AUDIO_CHUNK || inst->snd == NULL || inst->snd->buffer_lend_fn == NULL) {
+    return 0;
   }
+  return inst->snd->buffer_lend_fn(buffer);
+}
 
-  if (inst->mode->event_handle_fn != NULL) {
-    res = inst->mode->event_handle_fn(packet_type, evt);
-  } else {
-    res = wsat_event_handle_default(packet_type, evt);
-  }
+void wsat_event_handle(struct wsat_decoded_event* evt)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  const enum wsat_packet_type packet_type = evt->packet_type;
+  // Default handler goes first, mode handler can then react on the same event.
+  const wsat_event_handler_fn default_fn = wsat_event_default_handlers[packet_type];
+  const wsat_event_handler_fn mode_fn = inst->mode->event_handlers != NULL ? inst->mode->event_handlers[packet_type] : NULL;
+
+  if (default_fn != NULL) default_fn(evt);
+  if (mode_fn != NULL) mode_fn(evt);
 
-  if (res == 0) {
+  if (default_fn == NULL && mode_fn == NULL) {
     LOGD("Packet type \"%s\" was not handled", evt->header.type);
 #if 1
-    char* header = cJSON_PrintUnformatted(evt->header.json);
-    LOGD("Header: %s", header);
-    free(header);
-    if (evt->data != NULL) {
-      char* data = cJSON_PrintUnformatted(evt->data);
-      LOGD("Data: %s", data);
-      free(data);
+    LOGD("Header: data_length %u, payload_length %u", evt->header.data_length, evt->header.payload_length);
+    if (evt->data_span.json != NULL) {
+      LOGD("Data: %.*s", (int)evt->data_span.length, evt->data_span.json);
     }
 #endif
   }
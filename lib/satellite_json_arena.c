@@ -0,0 +1,81 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Optional bump allocator for cJSON, enabled by WSAT_JSON_ARENA_SIZE.
+ * All cJSON nodes and strings of one event are allocated from arena, and freeing them does nothing.
+ * Whole arena is reset at once when the event is done, so small allocations don't fragment the heap.
+ * Every thread has its own current arena. Allocations outside of arena, or not fitting into it, go to heap.
+ */
+
+#include <string.h>
+
+#include "satellite_priv.h"
+
+#if WSAT_JSON_ARENA_SIZE > 0
+
+static PLAT_THREAD_LOCAL struct wsat_json_arena* wsat_json_arena_current;
+
+static bool wsat_json_arena_owns(struct wsat_json_arena* arena, void* ptr)
+{
+  return (uint8_t*)ptr >= arena->buffer && (uint8_t*)ptr < arena->buffer + WSAT_JSON_ARENA_SIZE;
+}
+
+static void* wsat_json_arena_malloc(size_t size)
+{
+  struct wsat_json_arena* arena = wsat_json_arena_current;
+  if (arena != NULL) {
+    const size_t aligned_size = (size + WSAT_JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(WSAT_JSON_ARENA_ALIGNMENT - 1);
+    if (aligned_size <= WSAT_JSON_ARENA_SIZE - arena->used) {
+      void* ptr = arena->buffer + arena->used;
+      arena->used += aligned_size;
+      if (arena->used > arena->stats.high_water) arena->stats.high_water = arena->used;
+      return ptr;
+    }
+    arena->stats.overflow_count++;
+  }
+  return PLAT_MALLOC(size);
+}
+
+static void wsat_json_arena_free(void* ptr)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  // Arena memory is released all at once, when its scope ends.
+  if (wsat_json_arena_owns(&inst->event_arena, ptr)) return;
+  PLAT_FREE(ptr);
+}
+
+// cJSON has no way to get hooks set before, so the ones of application are replaced, and not restored later.
+// Allocations outside of arena go to PLAT_MALLOC, which is where application routes them to its allocator.
+void wsat_json_arena_init()
+{
+  cJSON_Hooks hooks = { wsat_json_arena_malloc, wsat_json_arena_free };
+  cJSON_InitHooks(&hooks);
+}
+
+// Back to cJSON defaults, application sets its hooks again, if it needs them
+void wsat_json_arena_destroy()
+{
+  cJSON_InitHooks(NULL);
+}
+
+void wsat_json_arena_enter(struct wsat_json_arena* arena)
+{
+  // Nested scopes, e.g. response sent from event handler, just continue in already entered arena.
+  if (wsat_json_arena_current != NULL) {
+    wsat_json_arena_current->depth++;
+    return;
+  }
+  arena->depth = 1;
+  wsat_json_arena_current = arena;
+}
+
+void wsat_json_arena_leave()
+{
+  struct wsat_json_arena* arena = wsat_json_arena_current;
+  if (arena == NULL || --arena->depth > 0) return;
+  arena->used = 0;
+  wsat_json_arena_current = NULL;
+}
+
+#endif
@@ -0,0 +1,140 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Minimal JSON writer for outbound events, rendering straight into given buffer without any allocation.
+ * When the buffer is too small, the writer stops writing and remembers it, so it's checked only once at the end.
+ * Commas are tracked only for current object or array, which is enough, as closed one is always a value of its parent.
+ */
+
+#include <string.h>
+
+#include "satellite_priv.h"
+
+void wsat_json_writer_init(struct wsat_json_writer* writer, char* buffer, uint32_t capacity)
+{
+  writer->buffer = buffer;
+  writer->capacity = capacity;
+  writer->length = 0;
+  writer->is_overflow = false;
+  writer->is_first = true;
+}
+
+void wsat_json_writer_raw(struct wsat_json_writer* writer, const char* data, uint32_t length)
+{
+  if (writer->is_overflow || length > writer->capacity - writer->length) {
+    writer->is_overflow = true;
+    return;
+  }
+  memcpy(writer->buffer + writer->length, data, length);
+  writer->length += length;
+}
+
+static void wsat_json_writer_char(struct wsat_json_writer* writer, char c)
+{
+  wsat_json_writer_raw(writer, &c, 1);
+}
+
+static void wsat_json_writer_quoted(struct wsat_json_writer* writer, const char* str)
+{
+  static const char hex[] = "0123456789abcdef";
+  wsat_json_writer_char(writer, '"');
+  const char* run = str;
+  for (const char* c = str; *c != '\0'; c++) {
+    const uint8_t ch = (uint8_t)*c;
+    if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+    // Characters, which don't need escaping, are copied at once
+    wsat_json_writer_raw(writer, run, c - run);
+    run = c + 1;
+    if (ch == '"' || ch == '\\') {
+      const char escaped[2] = { '\\', (char)ch };
+      wsat_json_writer_raw(writer, escaped, 2);
+    } else if (ch == '\n') {
+      wsat_json_writer_raw(writer, "\\n", 2);
+    } else {
+      const char escaped[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF] };
+      wsat_json_writer_raw(writer, escaped, 6);
+    }
+  }
+  wsat_json_writer_raw(writer, run, strlen(run));
+  wsat_json_writer_char(writer, '"');
+}
+
+// Writes comma if needed and key, if the value is inside of object
+static void wsat_json_writer_key(struct wsat_json_writer* writer, const char* key)
+{
+  if (!writer->is_first) wsat_json_writer_char(writer, ',');
+  writer->is_first = false;
+  if (key == NULL) return;
+  wsat_json_writer_quoted(writer, key);
+  wsat_json_writer_char(writer, ':');
+}
+
+void wsat_json_writer_object_begin(struct wsat_json_writer* writer, const char* key)
+{
+  wsat_json_writer_key(writer, key);
+  wsat_json_writer_char(writer, '{');
+  writer->is_first = true;
+}
+
+void wsat_json_writer_object_end(struct wsat_json_writer* writer)
+{
+  wsat_json_writer_char(writer, '}');
+  writer->is_first = false;
+}
+
+void wsat_json_writer_array_begin(struct wsat_json_writer* writer, const char* key)
+{
+  wsat_json_writer_key(writer, key);
+  wsat_json_writer_char(writer, '[');
+  writer->is_first = true;
+}
+
+void wsat_json_writer_array_end(struct wsat_json_writer* writer)
+{
+  wsat_json_writer_char(writer, ']');
+  writer->is_first = false;
+}
+
+void wsat_json_writer_string(struct wsat_json_writer* writer, const char* key, const char* value)
+{
+  if (value == NULL) {
+    wsat_json_writer_null(writer, key);
+    return;
+  }
+  wsat_json_writer_key(writer, key);
+  wsat_json_writer_quoted(writer, value);
+}
+
+void wsat_json_writer_uint_value(struct wsat_json_writer* writer, uint64_t value)
+{
+  char digits[20];
+  uint32_t i = sizeof(digits);
+  do {
+    digits[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  wsat_json_writer_raw(writer, digits + i, sizeof(digits) - i);
+}
+
+void wsat_json_writer_uint(struct wsat_json_writer* writer, const char* key, uint64_t value)
+{
+  wsat_json_writer_key(writer, key);
+  wsat_json_writer_uint_value(writer, value);
+}
+
+void wsat_json_writer_bool(struct wsat_json_writer* writer, const char* key, bool value)
+{
+  wsat_json_writer_key(writer, key);
+  if (value) {
+    wsat_json_writer_raw(writer, "true", 4);
+  } else {
+    wsat_json_writer_raw(writer, "false", 5);
+  }
+}
+
+void wsat_json_writer_null(struct wsat_json_writer* writer, const char* key)
+{
+  wsat_json_writer_key(writer, key);
+  wsat_json_writer_raw(writer, "null", 4);
+}
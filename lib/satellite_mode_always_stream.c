@@ -77,6 +77,7 @@ static int32_t wsat_mode_init()
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_mode_always_stream_inst* mode_inst = &inst->mode_inst.always_stream;
   mode_inst->is_streaming = false;
+  mode_inst->is_chunk_stale = false;
   PLAT_MUTEX_CREATE(&mode_inst->is_streaming_mutex); // TODO: Error handling
   return 0;
 }
@@ -89,6 +90,14 @@ static int32_t wsat_mode_destroy()
   return 0;
 }
 
+// Called with is_streaming_mutex held, from server thread. Audio chunk is owned by the thread calling
+// wsat_mic_write_data, so its partial audio is only marked here, and dropped there before anything else is sent.
+static void wsat_mode_streaming_stop(struct wsat_mode_always_stream_inst* mode_inst)
+{
+  if (mode_inst->is_streaming) mode_inst->is_chunk_stale = true;
+  mode_inst->is_streaming = false;
+}
+
 static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* data)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
@@ -97,15 +106,19 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
   case WSAT_SYS_EVENT_MIC_DATA: {
     PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
     bool is_streaming = mode_inst->is_streaming;
+    const bool is_chunk_stale = mode_inst->is_chunk_stale;
+    mode_inst->is_chunk_stale = false;
     PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
+    // Audio gathered before satellite was paused or disconnected would arrive after that, so it's dropped
+    if (is_chunk_stale) wsat_audio_chunk_discard();
     if (!is_streaming) return 0;
     struct wsat_sys_event_buffer_params* buffer = data;
-    wsat_audio_chunk_send(buffer->data, buffer->size);
+    wsat_audio_chunk_write(buffer->data, buffer->size);
     break;
   }
   case WSAT_SYS_EVENT_SAT_DISCONNECT: {
     PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
-    mode_inst->is_streaming = false;
+    wsat_mode_streaming_stop(mode_inst);
     PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
   }
   default: break;
@@ -113,30 +126,32 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
   return 0;
 }
 
-static int32_t wsat_mode_event_handle(enum wsat_packet_type event_type, struct wsat_decoded_event* evt)
+static int32_t handle_run_satellite(struct wsat_decoded_event* evt)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_mode_always_stream_inst* mode_inst = &inst->mode_inst.always_stream;
-  int32_t res = wsat_event_handle_default(event_type, evt);
-  switch (event_type) {
-  case WSAT_EVENT_TYPE_RUN_SATELLITE:
-    wsat_run_pipeline_send(NULL);
-    PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
-    mode_inst->is_streaming = true;
-    PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
-    res = 1;
-    break;
-  case WSAT_EVENT_TYPE_PAUSE_SATELLITE:
-    PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
-    mode_inst->is_streaming = false;
-    PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
-    res = 1;
-    break;
-  default: break;
-  }
-  return res;
+  wsat_run_pipeline_send(NULL);
+  PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
+  mode_inst->is_streaming = true;
+  PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
+  return 0;
+}
+
+static int32_t handle_pause_satellite(struct wsat_decoded_event* evt)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mode_always_stream_inst* mode_inst = &inst->mode_inst.always_stream;
+  PLAT_MUTEX_LOCK(&mode_inst->is_streaming_mutex);
+  wsat_mode_streaming_stop(mode_inst);
+  PLAT_MUTEX_UNLOCK(&mode_inst->is_streaming_mutex);
+  return 0;
 }
 
+static const wsat_event_handler_fn wsat_mode_event_handlers[WSAT_EVENT_TYPE_COUNT] = {
+  [WSAT_EVENT_TYPE_RUN_SATELLITE] =   handle_run_satellite,
+  [WSAT_EVENT_TYPE_PAUSE_SATELLITE] = handle_pause_satellite,
+};
+
 struct wsat_mode wsat_mode_always_stream = {
   {
     WSAT_COMPONENT_TYPE_MODE,
@@ -145,5 +160,5 @@ struct wsat_mode wsat_mode_always_stream = {
     wsat_mode_sys_event_handle,
   },
   WSAT_MODE_ALWAYS_STREAM,
-  wsat_mode_event_handle,
+  wsat_mode_event_handlers,
 };
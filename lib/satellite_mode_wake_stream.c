@@ -101,6 +101,7 @@ static int32_t wsat_mode_init()
   struct wsat_mode_wake_stream_inst* mode_inst = &inst->mode_inst.wake_stream;
   mode_inst->is_streaming = false;
   mode_inst->is_paused = false;
+  mode_inst->is_chunk_stale = false;
   PLAT_MUTEX_CREATE(&mode_inst->state_mutex); // TODO: Error handling
   return 0;
 }
@@ -113,6 +114,14 @@ static int32_t wsat_mode_destroy()
   return 0;
 }
 
+// Called with state_mutex held, from server thread. Audio chunk is owned by the thread calling
+// wsat_mic_write_data, so its partial audio is only marked here, and dropped there before anything else is sent.
+static void wsat_mode_streaming_stop(struct wsat_mode_wake_stream_inst* mode_inst)
+{
+  if (mode_inst->is_streaming) mode_inst->is_chunk_stale = true;
+  mode_inst->is_streaming = false;
+}
+
 static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* data)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
@@ -121,7 +130,7 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
   switch (type) {
   case WSAT_SYS_EVENT_SAT_DISCONNECT: {
     PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
-    mode_inst->is_streaming = false;
+    wsat_mode_streaming_stop(mode_inst);
     mode_inst->is_paused = false;
     PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
     break;
@@ -130,11 +139,15 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
     PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
     bool is_streaming = mode_inst->is_streaming;
     bool is_paused = mode_inst->is_paused;
+    const bool is_chunk_stale = mode_inst->is_chunk_stale;
+    mode_inst->is_chunk_stale = false;
     PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
+    // Audio gathered before the pipeline ended or satellite was paused would arrive after that, so it's dropped
+    if (is_chunk_stale) wsat_audio_chunk_discard();
     if (is_paused) return 0;
     struct wsat_sys_event_buffer_params* buffer = data;
     if (is_streaming) {
-      wsat_audio_chunk_send(buffer->data, buffer->size);
+      wsat_audio_chunk_write(buffer->data, buffer->size);
     } else {
       // TODO: Send to wake
     }
@@ -150,22 +163,18 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
     PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
     if (is_streaming || is_paused) return 0;
 
-    cJSON* header = cJSON_CreateObject();
-    cJSON_AddStringToObject(header, "type", "detection");
-    cJSON_AddStringToObject(header, "version", "1.5.2");
-
-    cJSON* data_obj = cJSON_CreateObject();
-    cJSON_AddStringToObject(data_obj, "name", inst->wake->name);
-    cJSON_AddNumberToObject(data_obj, "timestamp", 4879521185556); // TODO
-
-    struct wsat_event res_pkt = {
-      .header = header,
-      .data = data_obj
-    };
-    wsat_event_send(&res_pkt);
-    wsat_event_free(&res_pkt, false);
-
-    wsat_run_pipeline_send(NULL);
+    // Detection and run-pipeline are sent together
+    if (wsat_event_batch_begin(WSAT_SEND_CLASS_CONTROL)) {
+      struct wsat_json_writer* data_obj = wsat_event_batch_write_begin();
+      wsat_json_writer_object_begin(data_obj, NULL);
+      wsat_json_writer_string(data_obj, "name", inst->wake->name);
+      wsat_json_writer_uint(data_obj, "timestamp", 4879521185556); // TODO
+      wsat_json_writer_object_end(data_obj);
+      static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("detection", "1.5.2");
+      wsat_event_batch_write_end(header, sizeof(header) - 1, NULL, 0);
+      wsat_run_pipeline_write(NULL);
+      wsat_event_batch_end();
+    }
 
     break;
   }
@@ -174,44 +183,48 @@ static int32_t wsat_mode_sys_event_handle(enum wsat_sys_event_type type, void* d
   return 0;
 }
 
-static int32_t wsat_mode_event_handle(enum wsat_packet_type event_type, struct wsat_decoded_event* evt)
+// The separate explicit locks are intentional in case some other event will not need lock :)
+
+static int32_t handle_run_satellite(struct wsat_decoded_event* evt)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_mode_wake_stream_inst* mode_inst = &inst->mode_inst.wake_stream;
-  int32_t res = wsat_event_handle_default(event_type, evt);
+  PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
+  wsat_mode_streaming_stop(mode_inst);
+  mode_inst->is_paused = false;
+  PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
+  return 0;
+}
 
-  // The separate explicit locks are intentional in case some other event will not need lock :)
+static int32_t handle_pause_satellite(struct wsat_decoded_event* evt)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mode_wake_stream_inst* mode_inst = &inst->mode_inst.wake_stream;
+  PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
+  wsat_mode_streaming_stop(mode_inst);
+  mode_inst->is_paused = true;
+  PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
+  return 0;
+}
 
-  switch (event_type) {
-  case WSAT_EVENT_TYPE_RUN_SATELLITE: {
-    PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
-    mode_inst->is_streaming = false;
-    mode_inst->is_paused = false;
-    PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
-    res = 1;
-    break;
-  }
-  case WSAT_EVENT_TYPE_PAUSE_SATELLITE: {
-    PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
-    mode_inst->is_streaming = false;
-    mode_inst->is_paused = true;
-    PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
-    res = 1;
-    break;
-  }
-  case WSAT_EVENT_TYPE_TRANSCRIPT:
-  case WSAT_EVENT_TYPE_ERROR: {
-    PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
-    mode_inst->is_streaming = false;
-    PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
-    res = 1;
-    break;
-  }
-  default: break;
-  }
-  return res;
+// Pipeline ended, either with transcript or with error
+static int32_t handle_pipeline_end(struct wsat_decoded_event* evt)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_mode_wake_stream_inst* mode_inst = &inst->mode_inst.wake_stream;
+  PLAT_MUTEX_LOCK(&mode_inst->state_mutex);
+  wsat_mode_streaming_stop(mode_inst);
+  PLAT_MUTEX_UNLOCK(&mode_inst->state_mutex);
+  return 0;
 }
 
+static const wsat_event_handler_fn wsat_mode_event_handlers[WSAT_EVENT_TYPE_COUNT] = {
+  [WSAT_EVENT_TYPE_RUN_SATELLITE] =   handle_run_satellite,
+  [WSAT_EVENT_TYPE_PAUSE_SATELLITE] = handle_pause_satellite,
+  [WSAT_EVENT_TYPE_TRANSCRIPT] =      handle_pipeline_end,
+  [WSAT_EVENT_TYPE_ERROR] =           handle_pipeline_end,
+};
+
 struct wsat_mode wsat_mode_wake_stream = {
   {
     WSAT_COMPONENT_TYPE_MODE,
@@ -220,5 +233,5 @@ struct wsat_mode wsat_mode_wake_stream = {
     wsat_mode_sys_event_handle,
   },
   WSAT_MODE_WAKE_STREAM,
-  wsat_mode_event_handle,
+  wsat_mode_event_handlers,
 };
\ No newline at end of file
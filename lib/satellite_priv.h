@@ -12,6 +12,184 @@
 
 #define ARRAY_LENGTH(x) (sizeof(x) / sizeof((x)[0]))
 
+#ifndef EVENT_DECODER_PAYLOAD_ALIGNMENT
+#define EVENT_DECODER_PAYLOAD_ALIGNMENT (16)
+#endif
+
+// Ring is never filled completely, so there is always room to move payload forward into alignment
+#define EVENT_DECODER_RING_CAPACITY (EVENT_DECODER_BUFFER_SIZE - (EVENT_DECODER_PAYLOAD_ALIGNMENT - 1))
+
+// Payload is streamed in chunks, so its length is limited only to catch garbage headers
+#ifndef EVENT_DECODER_PAYLOAD_MAX_LENGTH
+#define EVENT_DECODER_PAYLOAD_MAX_LENGTH (128 * 1024)
+#endif
+
+// Headers and data blocks, which don't fit into the decoder buffer, can be collected in spill buffer
+// allocated with PLAT_MALLOC, growing up to this size. It's freed again when such event is done.
+// 0 disables allocation, spill buffer can be still provided with wsat_spill_buffer_set.
+#ifndef EVENT_DECODER_SPILL_MAX_SIZE
+#define EVENT_DECODER_SPILL_MAX_SIZE (0)
+#endif
+
+// When audio is read into buffer lent by sound component, only this many bytes following the payload are read
+// into decoder buffer by the same read, so most of the next payload can be read into lent buffer again.
+#ifndef EVENT_DECODER_LENT_READ_AHEAD
+#define EVENT_DECODER_LENT_READ_AHEAD (256)
+#endif
+
+// Outbound events are rendered into send buffer, where header is placed right before data, so both go out at once.
+// Data of built-in events always fit, bigger events sent with wsat_event_send are printed with cJSON allocator instead.
+#ifndef WSAT_SEND_BUFFER_SIZE
+#define WSAT_SEND_BUFFER_SIZE (2048)
+#endif
+
+// Data of info event are rendered once into buffer of this size, when components are set
+#ifndef WSAT_INFO_DATA_SIZE
+#define WSAT_INFO_DATA_SIZE (1024)
+#endif
+
+#ifndef WSAT_SEND_HEADER_MAX_SIZE
+#define WSAT_SEND_HEADER_MAX_SIZE (256)
+#endif
+
+// Events sent in one batch are queued as iovecs and sent by single sendmsg, each takes up to 3 of them
+#ifndef WSAT_SEND_IOV_MAX
+#define WSAT_SEND_IOV_MAX (8)
+#endif
+
+// Optional queue of outbound bytes, sent by dedicated thread, see satellite_send_queue.c. 0 disables it,
+// and events are sent directly by the thread which produced them. Must fit the biggest event, including payload.
+#ifndef WSAT_SEND_QUEUE_SIZE
+#define WSAT_SEND_QUEUE_SIZE (0)
+#endif
+
+// Separate queue for control events, which are sent before anything in the main queue. Must fit info event.
+#ifndef WSAT_SEND_QUEUE_CONTROL_SIZE
+#define WSAT_SEND_QUEUE_CONTROL_SIZE (4096)
+#endif
+
+// Send thread writes queued units of one class by single sendmsg with up to this many iovecs, each unit takes 1 or 2
+#ifndef WSAT_SEND_QUEUE_IOV_MAX
+#define WSAT_SEND_QUEUE_IOV_MAX (16)
+#endif
+
+// Send thread writes into socket, and keeps iovecs of one batch on its stack, passed to PLAT_THREAD_CREATE
+#ifndef WSAT_SEND_THREAD_STACK_SIZE
+#define WSAT_SEND_THREAD_STACK_SIZE (4096)
+#endif
+
+#ifndef WSAT_SEND_THREAD_PRIORITY
+#define WSAT_SEND_THREAD_PRIORITY (0)
+#endif
+
+// Every outbound event must be written into socket until its deadline, counted from the moment it was ready.
+// Event, which couldn't be written at all, is dropped. Event already partially written gets WSAT_SEND_OVERDUE_DROP_MS
+// to finish, and then the connection is dropped, as the stream can't continue. The connection is dropped also
+// when no event makes its deadline for WSAT_SEND_OVERDUE_DROP_MS (only with PLAT_TIME_US).
+#ifndef WSAT_SEND_DEADLINE_CONTROL_MS
+#define WSAT_SEND_DEADLINE_CONTROL_MS (2000)
+#endif
+
+#ifndef WSAT_SEND_DEADLINE_BULK_MS
+#define WSAT_SEND_DEADLINE_BULK_MS (500)
+#endif
+
+#ifndef WSAT_SEND_OVERDUE_DROP_MS
+#define WSAT_SEND_OVERDUE_DROP_MS (5000)
+#endif
+
+// What to do with audio, when the server doesn't receive it as fast as it's produced
+#define WSAT_SEND_OVERLOAD_BLOCK (0) // Producer waits for space up to the deadline (needs PLAT_SEM_TAKE_TIMEOUT)
+#define WSAT_SEND_OVERLOAD_DROP_OLDEST (1) // Oldest queued audio is dropped, without send queue same as DROP_NEWEST
+#define WSAT_SEND_OVERLOAD_DROP_NEWEST (2) // New audio is dropped, without send queue when socket buffer is full
+#ifndef WSAT_SEND_OVERLOAD_POLICY
+#define WSAT_SEND_OVERLOAD_POLICY WSAT_SEND_OVERLOAD_DROP_OLDEST
+#endif
+
+// Microphone data are gathered into audio-chunk events of this duration, so the count of events doesn't depend
+// on block size of the capture driver. 0 sends every wsat_mic_write_data as one event.
+#ifndef WSAT_MIC_CHUNK_MS
+#define WSAT_MIC_CHUNK_MS (0)
+#endif
+
+// Chunk duration starts at WSAT_MIC_CHUNK_MS, and is adapted between these bounds. It grows when audio piles up
+// in send queue and socket, or round-trip time is long, to cut header overhead. It shrinks again when the link
+// is idle, for the lowest latency. Equal bounds keep the duration fixed.
+#ifndef WSAT_MIC_CHUNK_MIN_MS
+#define WSAT_MIC_CHUNK_MIN_MS WSAT_MIC_CHUNK_MS
+#endif
+
+#ifndef WSAT_MIC_CHUNK_MAX_MS
+#define WSAT_MIC_CHUNK_MAX_MS WSAT_MIC_CHUNK_MS
+#endif
+
+// Chunks are gathered here, longer durations are shortened to fit
+#ifndef WSAT_MIC_CHUNK_BUFFER_SIZE
+#define WSAT_MIC_CHUNK_BUFFER_SIZE (4096)
+#endif
+
+// Monotonic time in microseconds, used for statistics and deadlines. Without it, times are not measured,
+// and time spent waiting for socket or send queue is counted by the timed out waits, so deadlines still hold.
+#ifndef PLAT_TIME_US
+#define PLAT_TIME_US() (0)
+#define WSAT_TIME_NOT_MEASURED
+#endif
+
+// Server loop sleeps in poll() until socket or wakeup channel is ready, which is signaled by stop request,
+// so idle loop doesn't wake up at all. Channel is eventfd on Linux, pipe on other POSIX systems,
+// or platform can provide PLAT_WAKEUP_CREATE(fds), filling read and write end (e.g. with pair of connected
+// loopback sockets). Without any, the loop checks for stop request every WSAT_SERVER_POLL_MS.
+#define WSAT_WAKEUP_NONE (0)
+#define WSAT_WAKEUP_EVENTFD (1)
+#define WSAT_WAKEUP_PIPE (2)
+#define WSAT_WAKEUP_PLATFORM (3)
+#ifndef WSAT_WAKEUP
+#if defined(PLAT_WAKEUP_CREATE)
+#define WSAT_WAKEUP WSAT_WAKEUP_PLATFORM
+#elif defined(__linux__)
+#define WSAT_WAKEUP WSAT_WAKEUP_EVENTFD
+#elif defined(__unix__) || defined(__APPLE__)
+#define WSAT_WAKEUP WSAT_WAKEUP_PIPE
+#else
+#define WSAT_WAKEUP WSAT_WAKEUP_NONE
+#endif
+#endif
+
+#ifndef WSAT_SERVER_POLL_MS
+#define WSAT_SERVER_POLL_MS (250)
+#endif
+
+// Unix domain socket transport, see satellite_transport.c. Path is used, when no address is given.
+#ifndef WSAT_TRANSPORT_UNIX
+#if defined(__unix__) || defined(__APPLE__)
+#define WSAT_TRANSPORT_UNIX (1)
+#else
+#define WSAT_TRANSPORT_UNIX (0)
+#endif
+#endif
+
+#ifndef WSAT_TRANSPORT_UNIX_PATH
+#define WSAT_TRANSPORT_UNIX_PATH "/tmp/wyoming-satellite.sock"
+#endif
+
+// Size of each of two rings of in-process transport, see satellite_transport_loopback.c
+#ifndef WSAT_TRANSPORT_LOOPBACK_SIZE
+#define WSAT_TRANSPORT_LOOPBACK_SIZE (16 * 1024)
+#endif
+
+// Pre-rendered start of event header, lengths are appended when the event is sent
+#define WSAT_EVENT_HEADER_TEMPLATE(type, version) "{\"type\":\"" type "\",\"version\":\"" version "\""
+
+// Optional arena for cJSON allocations of one event, see satellite_json_arena.c. 0 disables it.
+// Arena replaces cJSON hooks of application between wsat_init and wsat_destroy, other allocations use PLAT_MALLOC.
+#ifndef WSAT_JSON_ARENA_SIZE
+#define WSAT_JSON_ARENA_SIZE (0)
+#endif
+
+#ifndef WSAT_JSON_ARENA_ALIGNMENT
+#define WSAT_JSON_ARENA_ALIGNMENT (sizeof(void*) > 8 ? sizeof(void*) : 8)
+#endif
+
 enum wsat_mode_type
 {
   WSAT_MODE_ALWAYS_STREAM,
@@ -32,18 +210,25 @@ enum wsat_packet_type
   WSAT_EVENT_TYPE_VOICE_STOPPED,
   WSAT_EVENT_TYPE_ERROR,
   WSAT_EVENT_TYPE_TRANSCRIPT,
+  WSAT_EVENT_TYPE_COUNT
 };
 
+#define WSAT_PACKET_TYPE_BIT(type) (1u << (type))
+_Static_assert(WSAT_EVENT_TYPE_COUNT <= 32, "Packet types must fit into 32-bit mask");
+
+typedef int32_t (* wsat_event_handler_fn)(struct wsat_decoded_event* evt);
+
 struct wsat_mode
 {
   struct wsat_component component;
   enum wsat_mode_type type;
-  int32_t (* event_handle_fn)(enum wsat_packet_type event_type, struct wsat_decoded_event* evt);
+  const wsat_event_handler_fn* event_handlers; // Indexed by enum wsat_packet_type, called after default handler
 };
 
 struct wsat_mode_always_stream_inst
 {
   bool is_streaming;
+  bool is_chunk_stale; // Streaming ended, so partial audio chunk must be dropped by the thread owning it
   PLAT_MUTEX_TYPE is_streaming_mutex;
 };
 
@@ -51,43 +236,162 @@ struct wsat_mode_wake_stream_inst
 {
   bool is_streaming;
   bool is_paused;
+  bool is_chunk_stale; // Streaming ended, so partial audio chunk must be dropped by the thread owning it
   PLAT_MUTEX_TYPE state_mutex;
 };
 
 extern struct wsat_mode wsat_mode_wake_stream;
 extern struct wsat_mode wsat_mode_always_stream;
 
+struct wsat_buffer_region
+{
+  uint8_t* data;
+  uint32_t length;
+};
+
 enum wsat_event_decoder_process_state
 {
   WSAT_EVENT_DECODER_PROCESS_STATE_HEADER,
   WSAT_EVENT_DECODER_PROCESS_STATE_DATA,
-  WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD
+  WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD,
+  WSAT_EVENT_DECODER_PROCESS_STATE_SKIP
+};
+
+struct wsat_event_decoder_spill
+{
+  uint8_t* data;
+  uint32_t capacity;
+  uint32_t length;
+  bool is_external; // Provided by user, never freed
 };
 
 struct wsat_event_decoder
 {
   enum wsat_event_decoder_process_state state;
+  uint32_t header_scanned; // How many bytes of incomplete header were already searched for its end
   struct wsat_decoded_event wip_evt;
-  uint8_t buffer[EVENT_DECODER_BUFFER_SIZE];
-  uint32_t buffer_length;
-  uint8_t payload_buffer[EVENT_DECODER_BUFFER_SIZE];
+  // Ring buffer. Payload chunks are handed out as views into it, so it's aligned for SIMD capable sinks.
+  _Alignas(EVENT_DECODER_PAYLOAD_ALIGNMENT) uint8_t buffer[EVENT_DECODER_BUFFER_SIZE];
+  uint32_t read_pos;
+  uint32_t write_pos;
+  uint32_t buffer_length; // Count of unprocessed bytes, starting at read_pos
   uint32_t payload_received;
+  uint32_t skip_mask; // Bit per enum wsat_packet_type, such events are skipped without being decoded
+  uint32_t skip_length; // Data and payload bytes of skipped event, which were not received yet
+  // Used only while header or data block bigger than the ring is collected
+  struct wsat_event_decoder_spill spill;
+  struct wsat_decoder_stats stats;
+};
+
+#if WSAT_JSON_ARENA_SIZE > 0
+struct wsat_json_arena
+{
+  _Alignas(16) uint8_t buffer[WSAT_JSON_ARENA_SIZE];
+  uint32_t used;
+  uint32_t depth; // Count of nested scopes
+  struct wsat_json_arena_stats stats;
+};
+#endif
+
+enum wsat_send_class
+{
+  WSAT_SEND_CLASS_CONTROL, // Small replies and notifications, which must not wait behind audio
+  WSAT_SEND_CLASS_BULK, // Audio chunks
+  WSAT_SEND_CLASS_COUNT
+};
+
+#if WSAT_SEND_QUEUE_SIZE > 0
+// Ring of pushed units, each is prefixed by struct wsat_send_queue_unit
+struct wsat_send_lane
+{
+  uint8_t* buffer;
+  uint32_t size;
+  uint32_t head;
+  uint32_t used;
+  uint32_t in_flight_length; // Oldest unit being written by send thread, it can't be dropped
+  uint32_t high_water;
+  uint32_t overload_drop_count;
+};
+
+struct wsat_send_queue
+{
+  PLAT_MUTEX_TYPE mutex;
+  PLAT_SEM_TYPE sem; // Given for every push and on stop, so the thread wakes up
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_BLOCK
+  PLAT_SEM_TYPE space_sem; // Given when the thread releases space, for producers waiting for it
+#endif
+  PLAT_THREAD_TYPE thread;
+  bool is_running;
+  bool is_stop_requested;
+  int connfd; // Connection, which queued bytes belong to, -1 drops everything pushed
+  uint32_t generation; // Incremented on every reset, so bytes taken before it are not released again
+  struct wsat_send_lane lanes[WSAT_SEND_CLASS_COUNT];
+  uint8_t control_buffer[WSAT_SEND_QUEUE_CONTROL_SIZE];
+  uint8_t bulk_buffer[WSAT_SEND_QUEUE_SIZE];
+};
+#endif
+
+#if WSAT_MIC_CHUNK_MS > 0
+// Touched only by the thread calling wsat_mic_write_data
+struct wsat_mic_chunk
+{
+  uint8_t buffer[WSAT_MIC_CHUNK_BUFFER_SIZE];
+  uint32_t used;
+  uint32_t size; // Bytes of current chunk duration, whole frames of microphone format
+  uint32_t min_size;
+  uint32_t max_size;
+  uint32_t frame_size;
+  uint32_t bytes_per_second;
+  struct wsat_mic_stats stats;
+};
+#endif
+
+struct wsat_json_writer
+{
+  char* buffer;
+  uint32_t capacity;
+  uint32_t length;
+  bool is_overflow; // Something didn't fit, so the output is not complete
+  bool is_first; // Nothing was written yet into current object, so next value needs no comma
 };
 
 struct wsat_server
 {
-  int sockfd;
+  const struct wsat_transport* transport;
+  int sockfd; // Handles of the transport, for socket transports they are file descriptors
   int connfd;
 
   PLAT_MUTEX_TYPE state_mutex;
   PLAT_MUTEX_TYPE send_mutex;
+  PLAT_MUTEX_TYPE run_mutex; // Held while server runs, so wsat_stop_wait can wait for it
   bool stop_requested;
+  int wakeup_fds[2]; // Read and write end of wakeup channel, readable once stop was requested
 
   struct wsat_event_decoder decoder;
+  // Liveness, used only by server loop. Without PLAT_TIME_US, time is counted by timed out waits of the loop.
+  bool is_ping_received;
+  uint64_t ping_received_us; // When peer pinged last
+  uint64_t waited_us; // Timed out waits since connection, stand in for clock when time is not measured
+
+  // Outbound events being rendered and queued, guarded by send_mutex
+  int send_connfd;
+  enum wsat_send_class send_class;
+  uint64_t send_start_us; // When current batch was started, for latency statistics
+  int32_t send_result; // First error of current batch
+  struct wsat_json_writer send_writer;
+  struct iovec send_iov[WSAT_SEND_IOV_MAX];
+  uint32_t send_iov_count;
+  uint32_t send_buffer_used; // Bytes of send buffer taken by queued events
+  struct wsat_send_stats send_stats; // Updated by the thread, which writes into socket
+  bool is_send_overdue; // Last event missed its deadline
+  uint64_t send_overdue_since_us;
+  char send_header[WSAT_SEND_HEADER_MAX_SIZE];
+  char send_buffer[WSAT_SEND_BUFFER_SIZE];
 };
 
 struct wsat_inst_priv
 {
+  struct wsat_config config;
   struct wsat_server server;
 
   struct wsat_mode* mode;
@@ -102,22 +406,115 @@ struct wsat_inst_priv
   struct wsat_microphone* mic;
   struct wsat_sound* snd;
   struct wsat_wake* wake;
+
+#if WSAT_SEND_QUEUE_SIZE > 0
+  struct wsat_send_queue send_queue;
+#endif
+#if WSAT_JSON_ARENA_SIZE > 0
+  struct wsat_json_arena event_arena; // Received event and responses sent from its handlers
+#endif
+  // Data of info event, answer to describe, rendered again only when some component changes. Guarded by send_mutex.
+  char info_data[WSAT_INFO_DATA_SIZE];
+  uint32_t info_data_length;
+  // Data of audio-chunk up to timestamp, rendered once as microphone format doesn't change
+  char audio_chunk_data_template[64];
+  uint32_t audio_chunk_data_template_length;
+#if WSAT_MIC_CHUNK_MS > 0
+  struct wsat_mic_chunk mic_chunk;
+#endif
 };
 
 extern struct wsat_inst_priv wsat_priv;
 
 int32_t wsat_server_run();
+void wsat_server_stop_request();
+void wsat_server_ping_received();
+
+void wsat_wakeup_create(int fds[2]);
+void wsat_wakeup_destroy(int fds[2]);
+void wsat_wakeup_signal(int fd);
+void wsat_wakeup_clear(int fd);
+int wsat_transport_poll(int fd, short events, int wakeup_fd, int32_t timeout_ms);
 int32_t wsat_run_pipeline_send(const char* pipeline_name);
+int32_t wsat_run_pipeline_write(const char* pipeline_name);
 int32_t wsat_audio_chunk_send(uint8_t* data, uint32_t length);
+int32_t wsat_audio_chunk_write(uint8_t* data, uint32_t length);
+int32_t wsat_audio_chunk_flush();
+void wsat_audio_chunk_discard();
+bool wsat_audio_chunk_lend(uint8_t** buffer, uint32_t* length);
+void wsat_audio_chunk_init();
+
+struct wsat_json_writer* wsat_event_write_begin(enum wsat_send_class send_class);
+int32_t wsat_event_write_end(const char* header_template, uint32_t header_template_length,
+                             const uint8_t* payload, uint32_t payload_length);
+// Batch sends multiple events with one syscall. Payloads must stay valid until wsat_event_batch_end.
+bool wsat_event_batch_begin(enum wsat_send_class send_class);
+struct wsat_json_writer* wsat_event_batch_write_begin();
+int32_t wsat_event_batch_write_end(const char* header_template, uint32_t header_template_length,
+                                   const uint8_t* payload, uint32_t payload_length);
+int32_t wsat_event_batch_end();
+int32_t wsat_event_batch_write_data(const char* header_template, uint32_t header_template_length,
+                                    const char* data, uint32_t data_length);
+int32_t wsat_send_unit(int fd, struct iovec* iov, uint32_t iov_count, bool is_more, enum wsat_send_class send_class,
+                       uint64_t start_us);
+
+#if WSAT_SEND_QUEUE_SIZE > 0
+void wsat_send_queue_init();
+void wsat_send_queue_destroy();
+int32_t wsat_send_queue_start();
+void wsat_send_queue_stop();
+void wsat_send_queue_reset(int connfd);
+int32_t wsat_send_queue_push(int connfd, enum wsat_send_class send_class, uint64_t start_us,
+                             const struct iovec* iov, uint32_t iov_count);
+void wsat_send_queue_stats_get(struct wsat_send_stats* stats);
+uint32_t wsat_send_queue_depth_get(enum wsat_send_class send_class);
+#endif
+void wsat_send_backlog_sample(uint32_t* backlog_bytes, uint32_t* rtt_us);
+
+void wsat_json_writer_init(struct wsat_json_writer* writer, char* buffer, uint32_t capacity);
+void wsat_json_writer_raw(struct wsat_json_writer* writer, const char* data, uint32_t length);
+void wsat_json_writer_object_begin(struct wsat_json_writer* writer, const char* key);
+void wsat_json_writer_object_end(struct wsat_json_writer* writer);
+void wsat_json_writer_array_begin(struct wsat_json_writer* writer, const char* key);
+void wsat_json_writer_array_end(struct wsat_json_writer* writer);
+void wsat_json_writer_string(struct wsat_json_writer* writer, const char* key, const char* value);
+void wsat_json_writer_uint_value(struct wsat_json_writer* writer, uint64_t value);
+void wsat_json_writer_uint(struct wsat_json_writer* writer, const char* key, uint64_t value);
+void wsat_json_writer_bool(struct wsat_json_writer* writer, const char* key, bool value);
+void wsat_json_writer_null(struct wsat_json_writer* writer, const char* key);
+
+extern const wsat_event_handler_fn wsat_event_default_handlers[WSAT_EVENT_TYPE_COUNT];
 
 void wsat_event_handle(struct wsat_decoded_event* evt);
-int32_t wsat_event_handle_default(enum wsat_packet_type packet_type, struct wsat_decoded_event* evt);
+void wsat_info_render();
+uint32_t wsat_event_interest_mask_get();
+uint32_t wsat_event_payload_lend(struct wsat_decoded_event* evt, uint8_t** buffer);
+
+#if WSAT_JSON_ARENA_SIZE > 0
+void wsat_json_arena_init();
+void wsat_json_arena_destroy();
+void wsat_json_arena_enter(struct wsat_json_arena* arena);
+void wsat_json_arena_leave();
+#else
+#define wsat_json_arena_init()
+#define wsat_json_arena_destroy()
+#define wsat_json_arena_enter(arena)
+#define wsat_json_arena_leave()
+#endif
 
+enum wsat_packet_type wsat_packet_type_get(const char* type);
+const uint8_t* wsat_find_byte_pair(const uint8_t* data, uint32_t length, uint8_t first, uint8_t second);
 void wsat_event_decoder_reset(struct wsat_event_decoder* dec);
-uint32_t wsat_event_decoder_buffer_get(struct wsat_event_decoder* dec, uint8_t** buffer);
+void wsat_event_decoder_skip_set(struct wsat_event_decoder* dec, uint32_t skip_mask);
+void wsat_event_decoder_spill_set(struct wsat_event_decoder* dec, uint8_t* buffer, uint32_t size);
+uint32_t wsat_event_decoder_buffer_get(struct wsat_event_decoder* dec, struct wsat_buffer_region regions[2]);
 void wsat_event_decoder_buffer_advance(struct wsat_event_decoder* dec, uint32_t length);
-int32_t wsat_event_decoder_next(struct wsat_event_decoder* dec, struct wsat_decoded_event* out_event);
+uint32_t wsat_event_decoder_payload_direct_length(struct wsat_event_decoder* dec);
+int32_t wsat_event_decoder_payload_direct(struct wsat_event_decoder* dec, uint8_t* data, uint32_t length,
+                                          struct wsat_decoded_event** out_event);
+int32_t wsat_event_decoder_next(struct wsat_event_decoder* dec, struct wsat_decoded_event** out_event);
 void wsat_decoded_event_free(struct wsat_decoded_event* evt);
+cJSON* wsat_decoded_event_get_data(struct wsat_decoded_event* evt);
 
 #if 0
 void wsat_process_data();
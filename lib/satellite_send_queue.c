@@ -0,0 +1,324 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Optional queue of outbound bytes, enabled by WSAT_SEND_QUEUE_SIZE.
+ * Events are still rendered by the producing thread, but instead of writing them into socket, they are copied
+ * into ring buffer and the producer returns at once. Dedicated thread writes the ring into socket, so full TCP window
+ * stalls only this thread, never the microphone capture. When the ring is full, WSAT_SEND_OVERLOAD_POLICY decides
+ * what happens with audio, control events are dropped. Units not written until their deadline are dropped too.
+ * There is one ring per send class. All units queued in one ring are written by single sendmsg, up to
+ * WSAT_SEND_QUEUE_IOV_MAX buffers, and before every batch of bulk units, all control units are sent, so pong
+ * or detection waits at most for one batch of audio chunks, which is already being written.
+ * Requires PLAT_SEM_* and PLAT_THREAD_* macros.
+ */
+
+#include <string.h>
+
+#include "satellite_priv.h"
+
+#if WSAT_SEND_QUEUE_SIZE > 0
+
+// Placed before every pushed unit
+struct wsat_send_queue_unit
+{
+  uint64_t push_time_us;
+  uint32_t length;
+};
+
+static void wsat_send_lane_write(struct wsat_send_lane* lane, const void* data, uint32_t length)
+{
+  const uint8_t* src = data;
+  while (length > 0) {
+    const uint32_t space = lane->size - lane->head;
+    const uint32_t copy_length = length < space ? length : space;
+    memcpy(lane->buffer + lane->head, src, copy_length);
+    lane->head = (lane->head + copy_length) % lane->size;
+    src += copy_length;
+    length -= copy_length;
+  }
+  lane->used += src - (const uint8_t*)data;
+}
+
+// Describes `length` bytes starting at `offset` from the oldest byte, returns count of regions
+static uint32_t wsat_send_lane_regions(struct wsat_send_lane* lane, uint32_t offset, uint32_t length,
+                                       struct iovec regions[2])
+{
+  const uint32_t start = (lane->head + lane->size - lane->used + offset) % lane->size;
+  const uint32_t first_length = lane->size - start < length ? lane->size - start : length;
+  regions[0].iov_base = lane->buffer + start;
+  regions[0].iov_len = first_length;
+  if (first_length == length) return 1;
+  regions[1].iov_base = lane->buffer;
+  regions[1].iov_len = length - first_length;
+  return 2;
+}
+
+static void wsat_send_lane_peek_unit(struct wsat_send_lane* lane, uint32_t offset, struct wsat_send_queue_unit* unit)
+{
+  struct iovec regions[2];
+  const uint32_t count = wsat_send_lane_regions(lane, offset, sizeof(*unit), regions);
+  memcpy(unit, regions[0].iov_base, regions[0].iov_len);
+  if (count > 1) memcpy((uint8_t*)unit + regions[0].iov_len, regions[1].iov_base, regions[1].iov_len);
+}
+
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_DROP_OLDEST
+// Removes `length` bytes at `offset` from the oldest byte, by moving newer bytes over them
+static void wsat_send_lane_remove(struct wsat_send_lane* lane, uint32_t offset, uint32_t length)
+{
+  const uint32_t tail = (lane->head + lane->size - lane->used) % lane->size;
+  uint32_t src = offset + length;
+  uint32_t dst = offset;
+  while (src < lane->used) {
+    const uint32_t src_index = (tail + src) % lane->size;
+    const uint32_t dst_index = (tail + dst) % lane->size;
+    uint32_t move_length = lane->used - src;
+    if (lane->size - src_index < move_length) move_length = lane->size - src_index;
+    if (lane->size - dst_index < move_length) move_length = lane->size - dst_index;
+    memmove(lane->buffer + dst_index, lane->buffer + src_index, move_length);
+    src += move_length;
+    dst += move_length;
+  }
+  lane->used -= length;
+  lane->head = (tail + lane->used) % lane->size;
+}
+
+// Drops oldest units, which are not being written, until there is `length` bytes free. Returns false if it's not possible.
+static bool wsat_send_lane_make_space(struct wsat_send_lane* lane, uint32_t length)
+{
+  while (length > lane->size - lane->used && lane->used > lane->in_flight_length) {
+    struct wsat_send_queue_unit unit;
+    wsat_send_lane_peek_unit(lane, lane->in_flight_length, &unit);
+    wsat_send_lane_remove(lane, lane->in_flight_length, sizeof(unit) + unit.length);
+    lane->overload_drop_count++;
+  }
+  return length <= lane->size - lane->used;
+}
+#endif
+
+static uint64_t wsat_send_queue_deadline_get(enum wsat_send_class send_class, uint64_t start_us)
+{
+  return start_us + (send_class == WSAT_SEND_CLASS_CONTROL ? WSAT_SEND_DEADLINE_CONTROL_MS
+                                                           : WSAT_SEND_DEADLINE_BULK_MS) * 1000ull;
+}
+
+static void* wsat_send_queue_thread_fn(void* opaque)
+{
+  (void)opaque;
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  while (true) {
+    PLAT_SEM_TAKE(&queue->sem);
+    PLAT_MUTEX_LOCK(&queue->mutex);
+    // Semaphore is given for every push, but one wake up sends everything queued, so the next ones may find nothing
+    while (!queue->is_stop_requested && queue->connfd >= 0) {
+      // Lanes are ordered by priority, and checked again after every batch
+      struct wsat_send_lane* lane = NULL;
+      for (uint32_t i = 0; i < WSAT_SEND_CLASS_COUNT && lane == NULL; i++) {
+        if (queue->lanes[i].used > 0) lane = &queue->lanes[i];
+      }
+      if (lane == NULL) break;
+      const enum wsat_send_class send_class = (enum wsat_send_class)(lane - queue->lanes);
+      struct wsat_send_queue_unit unit;
+      wsat_send_lane_peek_unit(lane, 0, &unit);
+      // Batch is written within deadline of its oldest unit. Unit already past it goes alone, so it's dropped
+      // without the newer ones.
+      const uint64_t start_us = unit.push_time_us;
+      const bool is_late = PLAT_TIME_US() >= wsat_send_queue_deadline_get(send_class, start_us);
+      struct iovec iov[WSAT_SEND_QUEUE_IOV_MAX];
+      uint32_t iov_count = 0;
+      uint32_t batch_length = 0;
+      do {
+        wsat_send_lane_peek_unit(lane, batch_length, &unit);
+        iov_count += wsat_send_lane_regions(lane, batch_length + sizeof(unit), unit.length, iov + iov_count);
+        batch_length += sizeof(unit) + unit.length;
+      } while (!is_late && batch_length < lane->used && iov_count + 2 <= WSAT_SEND_QUEUE_IOV_MAX);
+      const int connfd = queue->connfd;
+      const uint32_t generation = queue->generation;
+      lane->in_flight_length = batch_length;
+      PLAT_MUTEX_UNLOCK(&queue->mutex);
+
+      // Producers only append behind the head, and never drop units in flight, so they're not touched until released
+      const int32_t res = wsat_send_unit(connfd, iov, iov_count, false, send_class, start_us);
+      PLAT_MUTEX_LOCK(&queue->mutex);
+      if (queue->generation == generation) {
+        lane->used -= lane->in_flight_length;
+        lane->in_flight_length = 0;
+        if (res < 0 && res != -WSAT_ERROR_SEND_TIMEOUT) {
+          // Stream is broken now, nothing more can be sent until next connection
+          LOGE("Send thread failed to send: %d", res);
+          queue->connfd = -1;
+          for (uint32_t i = 0; i < WSAT_SEND_CLASS_COUNT; i++) queue->lanes[i].used = 0;
+        }
+      }
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_BLOCK
+      PLAT_SEM_GIVE(&queue->space_sem);
+#endif
+    }
+    const bool is_stop_requested = queue->is_stop_requested;
+    PLAT_MUTEX_UNLOCK(&queue->mutex);
+    if (is_stop_requested) break;
+  }
+  return NULL;
+}
+
+// Primitives live as long as the instance, so producer racing with stop of the server never touches destroyed ones
+void wsat_send_queue_init()
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  PLAT_MUTEX_CREATE(&queue->mutex); // TODO: Error check
+  PLAT_SEM_CREATE(&queue->sem, 0); // TODO: Error check
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_BLOCK
+  PLAT_SEM_CREATE(&queue->space_sem, 0); // TODO: Error check
+#endif
+  queue->connfd = -1;
+  queue->lanes[WSAT_SEND_CLASS_CONTROL].buffer = queue->control_buffer;
+  queue->lanes[WSAT_SEND_CLASS_CONTROL].size = sizeof(queue->control_buffer);
+  queue->lanes[WSAT_SEND_CLASS_BULK].buffer = queue->bulk_buffer;
+  queue->lanes[WSAT_SEND_CLASS_BULK].size = sizeof(queue->bulk_buffer);
+}
+
+void wsat_send_queue_destroy()
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_BLOCK
+  PLAT_SEM_DESTROY(&queue->space_sem);
+#endif
+  PLAT_SEM_DESTROY(&queue->sem);
+  PLAT_MUTEX_DESTROY(&queue->mutex);
+}
+
+int32_t wsat_send_queue_start()
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  queue->is_stop_requested = false;
+  queue->connfd = -1;
+  for (uint32_t i = 0; i < WSAT_SEND_CLASS_COUNT; i++) {
+    queue->lanes[i].head = 0;
+    queue->lanes[i].used = 0;
+    queue->lanes[i].in_flight_length = 0;
+  }
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+  if (PLAT_THREAD_CREATE(&queue->thread, wsat_send_queue_thread_fn, "wsat_send", WSAT_SEND_THREAD_STACK_SIZE,
+                         WSAT_SEND_THREAD_PRIORITY) != 0) {
+    LOGE("Failed to create send thread");
+    return -WSAT_ERROR_THREAD_CREATE;
+  }
+  queue->is_running = true;
+  return WSAT_OK;
+}
+
+void wsat_send_queue_stop()
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  if (!queue->is_running) return;
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  queue->is_stop_requested = true;
+  queue->connfd = -1; // Producers get refused from now on
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+  PLAT_SEM_GIVE(&queue->sem);
+  PLAT_THREAD_JOIN(&queue->thread);
+  queue->is_running = false;
+}
+
+// Drops everything queued, and accepts only events for given connection from now on.
+void wsat_send_queue_reset(int connfd)
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  queue->connfd = connfd;
+  queue->generation++;
+  for (uint32_t i = 0; i < WSAT_SEND_CLASS_COUNT; i++) {
+    queue->lanes[i].head = 0;
+    queue->lanes[i].used = 0;
+    queue->lanes[i].in_flight_length = 0;
+  }
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+}
+
+// Waits for `length` bytes of free space, or makes it, according to overload policy
+static bool wsat_send_queue_space_get(struct wsat_send_queue* queue, struct wsat_send_lane* lane, int connfd,
+                                      enum wsat_send_class send_class, uint64_t deadline_us, uint32_t length)
+{
+  if (length <= lane->size - lane->used) return true;
+  if (send_class == WSAT_SEND_CLASS_CONTROL) return false;
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_DROP_OLDEST
+  (void)queue;
+  (void)connfd;
+  (void)deadline_us;
+  return wsat_send_lane_make_space(lane, length);
+#elif WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_BLOCK
+  uint64_t waited_us = 0; // Timed out waits, stand in for clock when time is not measured
+  while (length > lane->size - lane->used && queue->connfd == connfd) {
+    const uint64_t now_us = PLAT_TIME_US() + waited_us;
+    if (now_us >= deadline_us) return false;
+    const uint32_t wait_ms = (uint32_t)((deadline_us - now_us + 999) / 1000);
+    PLAT_MUTEX_UNLOCK(&queue->mutex);
+    const int wait_res = PLAT_SEM_TAKE_TIMEOUT(&queue->space_sem, wait_ms);
+    PLAT_MUTEX_LOCK(&queue->mutex);
+#ifdef WSAT_TIME_NOT_MEASURED
+    if (wait_res != 0) waited_us += wait_ms * 1000ull;
+#else
+    (void)wait_res;
+#endif
+  }
+  return queue->connfd == connfd;
+#else
+  (void)queue;
+  (void)connfd;
+  (void)deadline_us;
+  return false;
+#endif
+}
+
+int32_t wsat_send_queue_push(int connfd, enum wsat_send_class send_class, uint64_t start_us,
+                             const struct iovec* iov, uint32_t iov_count)
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  struct wsat_send_lane* lane = &queue->lanes[send_class];
+  struct wsat_send_queue_unit unit = { start_us, 0 };
+  for (uint32_t i = 0; i < iov_count; i++) unit.length += iov[i].iov_len;
+  const uint64_t deadline_us = wsat_send_queue_deadline_get(send_class, start_us);
+
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  if (queue->connfd != connfd || connfd < 0) {
+    PLAT_MUTEX_UNLOCK(&queue->mutex);
+    return -WSAT_ERROR_SAT_DISCONNECTED;
+  }
+  if (!wsat_send_queue_space_get(queue, lane, connfd, send_class, deadline_us, sizeof(unit) + unit.length)) {
+    // Events are never split, as the other side couldn't parse the stream anymore
+    lane->overload_drop_count++;
+    PLAT_MUTEX_UNLOCK(&queue->mutex);
+    return -WSAT_ERROR_SEND_QUEUE_FULL;
+  }
+  wsat_send_lane_write(lane, &unit, sizeof(unit));
+  for (uint32_t i = 0; i < iov_count; i++) wsat_send_lane_write(lane, iov[i].iov_base, iov[i].iov_len);
+  if (lane->used > lane->high_water) lane->high_water = lane->used;
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+  PLAT_SEM_GIVE(&queue->sem);
+  return WSAT_OK;
+}
+
+uint32_t wsat_send_queue_depth_get(enum wsat_send_class send_class)
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  const uint32_t depth = queue->lanes[send_class].used;
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+  return depth;
+}
+
+void wsat_send_queue_stats_get(struct wsat_send_stats* stats)
+{
+  struct wsat_send_queue* queue = &wsat_priv.send_queue;
+  PLAT_MUTEX_LOCK(&queue->mutex);
+  struct wsat_send_class_stats* class_stats[WSAT_SEND_CLASS_COUNT] = { &stats->control, &stats->bulk };
+  for (uint32_t i = 0; i < WSAT_SEND_CLASS_COUNT; i++) {
+    class_stats[i]->queue_depth = queue->lanes[i].used;
+    class_stats[i]->queue_high_water = queue->lanes[i].high_water;
+    class_stats[i]->overload_drop_count += queue->lanes[i].overload_drop_count;
+  }
+  PLAT_MUTEX_UNLOCK(&queue->mutex);
+}
+
+#endif
@@ -7,12 +7,6 @@
 #include <string.h>
 #include "satellite_priv.h"
 
-#ifndef MSG_NOSIGNAL
-#define MSG_NOSIGNAL 0
-#endif
-
-#define WSAT_SEND_TIMEOUT_MS 250
-
 static bool is_stop_requested()
 {
   struct wsat_inst_priv* inst = &wsat_priv;
@@ -23,6 +17,73 @@ static bool is_stop_requested()
   return stop_requested;
 }
 
+// Called by wsat_stop from any thread. Wakeup channel is never drained, so everyone waiting on it,
+// server loop and send thread alike, wakes up for the stop request.
+void wsat_server_stop_request()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  PLAT_MUTEX_LOCK(&server->state_mutex);
+  if (!server->stop_requested && server->wakeup_fds[1] >= 0) wsat_wakeup_signal(server->wakeup_fds[1]);
+  server->stop_requested = true;
+  PLAT_MUTEX_UNLOCK(&server->state_mutex);
+}
+
+// Waits until `handle` can be read or written or stop is requested, `timeout_ms` -1 waits forever.
+// Returns 1 when `handle` is ready, 0 on stop request or timeout, -1 on error with errno set.
+static int wsat_server_wait(int handle, bool is_write, int32_t timeout_ms)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  PLAT_MUTEX_LOCK(&server->state_mutex);
+  const int wakeup_fd = server->wakeup_fds[0];
+  PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  if (wakeup_fd < 0 && (timeout_ms < 0 || timeout_ms > WSAT_SERVER_POLL_MS)) {
+    timeout_ms = WSAT_SERVER_POLL_MS; // Nothing would wake us up
+  }
+  return server->transport->wait_fn(handle, is_write, wakeup_fd, timeout_ms);
+}
+
+// Time for liveness, server loop adds its timed out waits, when time is not measured
+static uint64_t wsat_server_time_us()
+{
+  return PLAT_TIME_US() + wsat_priv.server.waited_us;
+}
+
+// Called when ping arrives, from server loop
+void wsat_server_ping_received()
+{
+  struct wsat_server* server = &wsat_priv.server;
+  server->is_ping_received = true;
+  server->ping_received_us = wsat_server_time_us();
+}
+
+// Time left until peer is considered dead, -1 while liveness isn't tracked.
+// Tracking starts with the first ping, peers which don't ping are left to TCP keepalive.
+static int32_t wsat_server_liveness_left_ms()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  if (inst->config.peer_timeout_s == 0 || !server->is_ping_received) return -1;
+  const uint64_t deadline_us = server->ping_received_us + inst->config.peer_timeout_s * 1000000ull;
+  const uint64_t now_us = wsat_server_time_us();
+  if (now_us >= deadline_us) return 0;
+  const uint64_t left_ms = (deadline_us - now_us + 999) / 1000;
+  return left_ms > INT32_MAX ? INT32_MAX : (int32_t)left_ms;
+}
+
+// Tells every component, that connection was made or ended
+static void wsat_server_sys_event_send(enum wsat_sys_event_type type)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  for (uint32_t i = 0; i < ARRAY_LENGTH(inst->components); i++) {
+    struct wsat_component* comp = inst->components[i];
+    if (comp != NULL && comp->sys_event_handle_fn != NULL) {
+      comp->sys_event_handle_fn(type, NULL);
+    }
+  }
+}
+
 static bool wsat_errno_is_retry(int err)
 {
   return err == EINTR;
@@ -54,25 +115,47 @@ static bool wsat_errno_is_conn_drop(int err)
          err == EHOSTUNREACH;
 }
 
+static void wsat_server_event_process(struct wsat_decoded_event* evt, bool* is_event_open)
+{
+#if 1
+  if (evt->flags & WSAT_DECODED_EVENT_FLAG_BEGIN) {
+    LOGD("Got event \"%s\"", evt->header.type);
+  }
+#endif
+  // JSON allocated while event is handled lives in arena, until the event ends.
+  if (evt->flags & WSAT_DECODED_EVENT_FLAG_BEGIN) {
+    wsat_json_arena_enter(&wsat_priv.event_arena);
+    *is_event_open = true;
+  }
+  wsat_event_handle(evt);
+  if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) {
+    wsat_decoded_event_free(evt);
+    wsat_json_arena_leave();
+    *is_event_open = false;
+  }
+}
+
 int32_t wsat_server_run()
 {
   int32_t res;
   int32_t ret = WSAT_OK;
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_server* server = &inst->server;
-  struct sockaddr_in serv_addr, client_addr;
-  int port, client_len;
+  const struct wsat_transport* transport = server->transport;
   int sockfd, connfd;
 
   PLAT_MUTEX_LOCK(&server->state_mutex);
   server->stop_requested = false;
   server->sockfd = sockfd = -1;
   server->connfd = connfd = -1;
+  wsat_wakeup_create(server->wakeup_fds);
   PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  if (WSAT_WAKEUP != WSAT_WAKEUP_NONE && server->wakeup_fds[0] < 0) {
+    LOGE("Wakeup channel couldn't be created, stop request is checked every %d ms", WSAT_SERVER_POLL_MS);
+  }
 
-  sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  sockfd = transport->listen_fn(&inst->config);
   if (sockfd < 0) {
-    LOGE("socket() failed");
     ret = -WSAT_ERROR_SOCKET;
     goto cleanup;
   }
@@ -80,53 +163,27 @@ int32_t wsat_server_run()
   server->sockfd = sockfd;
   PLAT_MUTEX_UNLOCK(&server->state_mutex);
 
-  memset((char*)&serv_addr, 0, sizeof(serv_addr));
-  port = 10700; // TODO: From config
-  serv_addr.sin_family = AF_INET;
-  serv_addr.sin_addr.s_addr = INADDR_ANY;
-  serv_addr.sin_port = htons(port);
-
-  const int enable = 1;
-  if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0) {
-    LOGE("setsockopt(SO_REUSEADDR) failed");
-    ret = -WSAT_ERROR_SOCKET;
-    goto cleanup;
-  }
-
-  if (bind(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-    LOGE("bind() failed, err: %d", errno);
-    ret = -WSAT_ERROR_SOCKET;
-    goto cleanup;
-  }
-
-  if (listen(sockfd, 1) < 0) {
-    LOGE("listen() failed, err: %d", errno);
-    ret = -WSAT_ERROR_SOCKET;
-    goto cleanup;
-  }
-
-  LOGD("Server listening on port %d", port);
+#if WSAT_SEND_QUEUE_SIZE > 0
+  ret = wsat_send_queue_start();
+  if (ret < 0) goto cleanup;
+#endif
 
-  // For graceful shutdowns, we use selects + timeouts. Pipes would work too, but there are no pipes in embedded env.
-  fd_set read_fds;
-  struct wsat_decoded_event evt;
+  // Loop sleeps until there is something to read or to accept, stop request wakes it through wakeup channel.
+  struct wsat_decoded_event* evt;
   struct wsat_event_decoder* dec = &server->decoder;
+  bool is_event_open = false;
 
   while (true) {
-    FD_ZERO(&read_fds);
-    FD_SET(sockfd, &read_fds);
-    struct timeval accept_timeout = {0, 250 * 1000};
-    res = select(sockfd + 1, &read_fds, NULL, NULL, &accept_timeout);
+    res = wsat_server_wait(sockfd, false, -1);
     if (res < 0) {
       if (wsat_errno_is_retry(errno)) continue;
-      LOGE("select() failed");
+      LOGE("poll() failed");
       ret = -WSAT_ERROR_SOCKET;
       goto cleanup;
     }
     if (is_stop_requested()) goto cleanup;
-    if (res == 0 || !FD_ISSET(sockfd, &read_fds)) continue; // Timeout or no new connection
-    client_len = sizeof(client_addr);
-    connfd = accept(sockfd, (struct sockaddr*)&client_addr, (socklen_t*)&client_len);
+    if (res == 0) continue; // No new connection
+    connfd = transport->accept_fn(sockfd, &inst->config);
     if (connfd < 0) {
       if (wsat_errno_is_retry(errno) || wsat_errno_is_accept_transient(errno)) continue;
       if (wsat_errno_is_fatal_listener(errno)) {
@@ -142,35 +199,73 @@ int32_t wsat_server_run()
     PLAT_MUTEX_LOCK(&server->state_mutex);
     server->connfd = connfd;
     PLAT_MUTEX_UNLOCK(&server->state_mutex);
+#if WSAT_SEND_QUEUE_SIZE > 0
+    wsat_send_queue_reset(connfd);
+#endif
     wsat_event_decoder_reset(dec);
+    server->is_ping_received = false;
+    server->waited_us = 0;
+    wsat_server_sys_event_send(WSAT_SYS_EVENT_SAT_CONNECT);
 
     while (true) {
-      FD_ZERO(&read_fds);
-      FD_SET(connfd, &read_fds);
-      struct timeval read_timeout = {0, 250 * 1000};
-      res = select(connfd + 1, &read_fds, NULL, NULL, &read_timeout);
+      // Loop wakes up also when peer should have pinged already
+      int32_t liveness_left_ms = wsat_server_liveness_left_ms();
+      if (liveness_left_ms == 0) {
+        LOGE("No ping for %u s, dropping connection", (unsigned)inst->config.peer_timeout_s);
+        break;
+      }
+#ifdef WSAT_TIME_NOT_MEASURED
+      if (liveness_left_ms > WSAT_SERVER_POLL_MS) liveness_left_ms = WSAT_SERVER_POLL_MS; // Wait may be cut to this
+#endif
+      res = wsat_server_wait(connfd, false, liveness_left_ms);
       if (res < 0) {
         if (wsat_errno_is_retry(errno)) continue;
-        if (wsat_errno_is_conn_drop(errno)) {
-          ret = 0;
-          break;
-        }
-        LOGE("select() failed");
+        LOGE("poll() failed");
         ret = -WSAT_ERROR_SOCKET;
         break;
       }
       if (is_stop_requested()) break;
-      if (res == 0 || !FD_ISSET(connfd, &read_fds)) continue;
-      // We received data!
-      uint8_t* read_buffer;
-      uint32_t capacity = wsat_event_decoder_buffer_get(dec, &read_buffer);
-      const ssize_t bytes_read = read(connfd, read_buffer, capacity);
+      if (res == 0) {
+#ifdef WSAT_TIME_NOT_MEASURED
+        // Only silence is counted, so peer is dropped at the latest, never before its timeout
+        if (liveness_left_ms > 0) server->waited_us += liveness_left_ms * 1000ull;
+#endif
+        continue;
+      }
+      // We received data! Read them straight into free space of decoder ring.
+      // If audio payload is expected and sound component lends its buffer, the payload is read into it instead.
+      struct wsat_buffer_region regions[2];
+      struct iovec read_iov[3];
+      uint32_t iov_count = 0;
+      uint8_t* lent_buffer = NULL;
+      uint32_t lent_length = 0;
+      const uint32_t direct_length = wsat_event_decoder_payload_direct_length(dec);
+      if (direct_length > 0) lent_length = wsat_event_payload_lend(&dec->wip_evt, &lent_buffer);
+      if (lent_length > direct_length) lent_length = direct_length;
+      if (lent_length > 0) {
+        read_iov[iov_count].iov_base = lent_buffer;
+        read_iov[iov_count].iov_len = lent_length;
+        iov_count++;
+      }
+      const uint32_t region_count = wsat_event_decoder_buffer_get(dec, regions);
+      uint32_t ring_length = lent_length > 0 ? EVENT_DECODER_LENT_READ_AHEAD : EVENT_DECODER_BUFFER_SIZE;
+      for (uint32_t i = 0; i < region_count && ring_length > 0; i++) {
+        read_iov[iov_count].iov_base = regions[i].data;
+        read_iov[iov_count].iov_len = regions[i].length < ring_length ? regions[i].length : ring_length;
+        ring_length -= read_iov[iov_count].iov_len;
+        iov_count++;
+      }
+      const int32_t bytes_read = transport->read_fn(connfd, read_iov, iov_count);
+      if (bytes_read <= 0 && lent_length > 0) {
+        // Lent buffer must be always returned
+        inst->snd->buffer_commit_fn(lent_buffer, 0);
+      }
       if (bytes_read == 0) {
         LOGD("Client disconnected");
         break;
       }
       if (bytes_read < 0) {
-        if (wsat_errno_is_retry(errno)) continue;
+        if (wsat_errno_is_retry(errno) || errno == EAGAIN || errno == EWOULDBLOCK) continue;
         if (wsat_errno_is_conn_drop(errno)) {
           ret = 0;
           break;
@@ -179,144 +274,456 @@ int32_t wsat_server_run()
         ret = -WSAT_ERROR_SOCKET;
         break;
       }
-      wsat_event_decoder_buffer_advance(dec, bytes_read);
-      uint32_t dec_res = 0;
-      do {
-        dec_res = wsat_event_decoder_next(dec, &evt);
-        if (dec_res == 1) {
-#if 1
-          if (evt.flags & WSAT_DECODED_EVENT_FLAG_BEGIN) {
-            LOGD("Got event \"%s\"", evt.header.type);
-          }
-#endif
-          wsat_event_handle(&evt);
-          if (evt.flags & WSAT_DECODED_EVENT_FLAG_END) {
-            wsat_decoded_event_free(&evt);
-          }
+      uint32_t ring_read = (uint32_t)bytes_read;
+      if (lent_length > 0) {
+        const uint32_t lent_read = ring_read < lent_length ? ring_read : lent_length;
+        ring_read -= lent_read;
+        if (wsat_event_decoder_payload_direct(dec, lent_buffer, lent_read, &evt) == 1) {
+          wsat_server_event_process(evt, &is_event_open);
         }
-      } while (dec_res != 0);
+      }
+      wsat_event_decoder_buffer_advance(dec, ring_read);
+      while (wsat_event_decoder_next(dec, &evt) == 1) {
+        wsat_server_event_process(evt, &is_event_open);
+      }
+    }
+    if (is_event_open) {
+      // Connection ended in the middle of event, its data must be freed before arena is reset
+      wsat_event_decoder_reset(dec);
+      wsat_json_arena_leave();
+      is_event_open = false;
     }
+#if WSAT_SEND_QUEUE_SIZE > 0
+    wsat_send_queue_reset(-1); // Events queued for closed connection are not sent anymore
+#endif
     PLAT_MUTEX_LOCK(&server->state_mutex);
-    close(connfd);
+    transport->close_fn(connfd);
     server->connfd = connfd = -1;
     PLAT_MUTEX_UNLOCK(&server->state_mutex);
-    if (ret < 0) break;
+    wsat_server_sys_event_send(WSAT_SYS_EVENT_SAT_DISCONNECT);
+    if (ret < 0 || is_stop_requested()) break;
   }
 
 cleanup:
+#if WSAT_SEND_QUEUE_SIZE > 0
+  wsat_send_queue_stop();
+#endif
   PLAT_MUTEX_LOCK(&server->state_mutex);
-  if (sockfd >= 0) close(sockfd);
+  if (sockfd >= 0) transport->close_fn(sockfd);
   server->sockfd = sockfd = -1;
+  wsat_wakeup_destroy(server->wakeup_fds);
   PLAT_MUTEX_UNLOCK(&server->state_mutex);
   return ret;
 }
 
-static int32_t wsat_send_all(int fd, const uint8_t* buffer, size_t length, int timeout_ms)
+static void wsat_send_stall_end(uint64_t stall_start_us)
 {
-  size_t sent = 0;
-  const size_t max_chunk = 4096;
-  while (sent < length) {
-    if (is_stop_requested()) return -WSAT_ERROR_SOCKET; // TODO: Maybe change to something else
-
-    fd_set write_fds;
-    FD_ZERO(&write_fds);
-    FD_SET(fd, &write_fds);
-    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
-    const int sel = select(fd + 1, NULL, &write_fds, NULL, &tv);
-    if (sel < 0) {
-      if (wsat_errno_is_retry(errno)) continue;
-      return -WSAT_ERROR_SOCKET;
-    }
-    if (sel == 0 || !FD_ISSET(fd, &write_fds)) {
-      continue;
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_send_stats* stats = &inst->server.send_stats;
+  const uint64_t stall_time_us = PLAT_TIME_US() - stall_start_us;
+  stats->stall_count++;
+  stats->stall_time_us += stall_time_us;
+  if (stall_time_us > stats->stall_time_max_us) stats->stall_time_max_us = (uint32_t)stall_time_us;
+}
+
+// Sends all buffers with as few syscalls as possible, `iov` is modified to track progress.
+// Waits for space in socket buffer only until deadline. Once something is written, the rest must follow,
+// so the deadline is moved to give the event WSAT_SEND_OVERDUE_DROP_MS to finish.
+static int32_t wsat_send_iov(int fd, struct iovec* iov, uint32_t iov_count, bool is_more, uint64_t deadline_us,
+                             bool* is_started)
+{
+  const struct wsat_transport* transport = wsat_priv.server.transport;
+  bool is_stalled = false;
+  uint64_t stall_start_us = 0;
+  uint64_t waited_us = 0; // Timed out waits, stand in for clock when time is not measured
+  int32_t ret = WSAT_OK;
+  *is_started = false;
+  while (iov_count > 0) {
+    if (is_stop_requested()) {
+      ret = -WSAT_ERROR_SOCKET; // TODO: Maybe change to something else
+      break;
     }
 
-    size_t remaining = length - sent;
-    size_t chunk = remaining > max_chunk ? max_chunk : remaining;
-    const ssize_t res = send(fd, buffer + sent, chunk, MSG_NOSIGNAL);
-    if (res > 0) {
-      sent += (size_t)res;
+    const int32_t res = transport->writev_fn(fd, iov, iov_count, is_more);
+    if (res < 0) {
+      if (wsat_errno_is_retry(errno)) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        ret = -WSAT_ERROR_SOCKET;
+        break;
+      }
+      // Socket buffer is full, wait until there is space again, but not past the deadline.
+      const uint64_t now_us = PLAT_TIME_US() + waited_us;
+      if (!is_stalled) {
+        is_stalled = true;
+        stall_start_us = now_us;
+      }
+      if (now_us >= deadline_us) {
+        ret = -WSAT_ERROR_SEND_TIMEOUT;
+        break;
+      }
+      // Stop request wakes the wait up too
+      uint64_t wait_ms = (deadline_us - now_us + 999) / 1000;
+#ifdef WSAT_TIME_NOT_MEASURED
+      if (wait_ms > WSAT_SERVER_POLL_MS) wait_ms = WSAT_SERVER_POLL_MS; // Wait may be cut to this, count it right
+#endif
+      const int wait_res = wsat_server_wait(fd, true, wait_ms > INT32_MAX ? INT32_MAX : (int32_t)wait_ms);
+      if (wait_res < 0 && !wsat_errno_is_retry(errno)) {
+        ret = -WSAT_ERROR_SOCKET;
+        break;
+      }
+#ifdef WSAT_TIME_NOT_MEASURED
+      if (wait_res == 0) waited_us += wait_ms * 1000;
+#endif
       continue;
     }
-    if (res < 0 && (wsat_errno_is_retry(errno) || errno == EAGAIN || errno == EWOULDBLOCK)) {
-      continue;
+    if (!*is_started && res > 0) {
+      *is_started = true;
+      const uint64_t finish_deadline_us = PLAT_TIME_US() + waited_us + WSAT_SEND_OVERDUE_DROP_MS * 1000ull;
+      if (finish_deadline_us > deadline_us) deadline_us = finish_deadline_us;
+    }
+    // Drop buffers which were sent, partially sent one continues where it ended.
+    size_t sent = (size_t)res;
+    while (iov_count > 0 && sent >= iov->iov_len) {
+      sent -= iov->iov_len;
+      iov++;
+      iov_count--;
+    }
+    if (iov_count > 0) {
+      iov->iov_base = (uint8_t*)iov->iov_base + sent;
+      iov->iov_len -= sent;
     }
-    return -WSAT_ERROR_SOCKET;
   }
-  return WSAT_OK;
+  if (is_stalled) wsat_send_stall_end(stall_start_us);
+  return ret;
 }
 
-int32_t wsat_event_send(struct wsat_event* evt)
+// Shuts the connection down, the server loop then sees it as disconnect and cleans up
+static void wsat_send_connection_drop(int fd)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  inst->server.send_stats.connection_drop_count++;
+  inst->server.is_send_overdue = false;
+  inst->server.transport->shutdown_fn(fd);
+}
+
+// Records how long it took from the event being ready until it was written into socket
+static void wsat_send_latency_add(struct wsat_send_class_stats* stats, uint64_t start_us)
+{
+  const uint64_t latency_us = PLAT_TIME_US() - start_us;
+  stats->sent_count++;
+  stats->latency_total_us += latency_us;
+  if (latency_us > stats->latency_max_us) stats->latency_max_us = (uint32_t)latency_us;
+}
+
+// Writes one unit of events into socket within deadline of its class, called only by the thread writing into socket.
+int32_t wsat_send_unit(int fd, struct iovec* iov, uint32_t iov_count, bool is_more, enum wsat_send_class send_class,
+                       uint64_t start_us)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  struct wsat_send_class_stats* stats = send_class == WSAT_SEND_CLASS_CONTROL ? &server->send_stats.control
+                                                                              : &server->send_stats.bulk;
+  const uint64_t deadline_us = start_us + (send_class == WSAT_SEND_CLASS_CONTROL ? WSAT_SEND_DEADLINE_CONTROL_MS
+                                                                                 : WSAT_SEND_DEADLINE_BULK_MS) * 1000ull;
+  bool is_started = false;
+  int32_t ret;
+#if WSAT_SEND_QUEUE_SIZE == 0 && WSAT_SEND_OVERLOAD_POLICY != WSAT_SEND_OVERLOAD_BLOCK
+  // Without queue, audio is either written right away, or dropped
+  const bool is_overload_drop = send_class == WSAT_SEND_CLASS_BULK;
+#else
+  const bool is_overload_drop = false;
+#endif
+  if (!is_overload_drop && PLAT_TIME_US() >= deadline_us) {
+    ret = -WSAT_ERROR_SEND_TIMEOUT; // Waited in queue for too long
+  } else {
+    ret = wsat_send_iov(fd, iov, iov_count, is_more, is_overload_drop ? 0 : deadline_us, &is_started);
+  }
+  if (ret == WSAT_OK) {
+    wsat_send_latency_add(stats, start_us);
+    server->is_send_overdue = false;
+    return WSAT_OK;
+  }
+  if (ret != -WSAT_ERROR_SEND_TIMEOUT) return ret;
+  if (is_started) {
+    LOGE("Event couldn't be finished in time, dropping connection");
+    wsat_send_connection_drop(fd);
+    return ret;
+  }
+  if (is_overload_drop) {
+    stats->overload_drop_count++;
+  } else {
+    stats->deadline_drop_count++;
+  }
+  const uint64_t now_us = PLAT_TIME_US();
+  if (!server->is_send_overdue) {
+    server->is_send_overdue = true;
+    server->send_overdue_since_us = now_us;
+  } else if (now_us - server->send_overdue_since_us >= WSAT_SEND_OVERDUE_DROP_MS * 1000ull) {
+    LOGE("No event was sent in time for %d ms, dropping connection", WSAT_SEND_OVERDUE_DROP_MS);
+    wsat_send_connection_drop(fd);
+  }
+  return ret;
+}
+
+// Bytes of outbound audio not yet received by server, waiting in send queue and in transport, and round-trip time.
+// Both are only sampled where the transport tells them, otherwise they are 0.
+void wsat_send_backlog_sample(uint32_t* backlog_bytes, uint32_t* rtt_us)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  *backlog_bytes = 0;
+  *rtt_us = 0;
+  PLAT_MUTEX_LOCK(&server->state_mutex);
+  const int connfd = server->connfd;
+  PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  if (connfd < 0) return;
+#if WSAT_SEND_QUEUE_SIZE > 0
+  *backlog_bytes += wsat_send_queue_depth_get(WSAT_SEND_CLASS_BULK);
+#endif
+  if (server->transport->backlog_fn != NULL) {
+    uint32_t queued_bytes = 0;
+    server->transport->backlog_fn(connfd, &queued_bytes, rtt_us);
+    *backlog_bytes += queued_bytes;
+  }
+}
+
+// Sends all queued events. If more events follow in the same batch, kernel is told to wait for them.
+static int32_t wsat_event_batch_flush(bool is_more)
 {
   struct wsat_inst_priv* inst = &wsat_priv;
   struct wsat_server* server = &inst->server;
   int32_t ret = WSAT_OK;
+  if (server->send_iov_count > 0) {
+#if WSAT_SEND_QUEUE_SIZE > 0
+    // Producer only copies the events into queue, send thread writes them into socket
+    (void)is_more;
+    ret = wsat_send_queue_push(server->send_connfd, server->send_class, server->send_start_us, server->send_iov,
+                               server->send_iov_count);
+#else
+    ret = wsat_send_unit(server->send_connfd, server->send_iov, server->send_iov_count, is_more,
+                         server->send_class, server->send_start_us);
+#endif
+  }
+  server->send_iov_count = 0;
+  server->send_buffer_used = 0;
+  return ret;
+}
+
+bool wsat_event_batch_begin(enum wsat_send_class send_class)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
   int connfd = -1;
+  const uint64_t start_us = PLAT_TIME_US(); // Waiting for other senders counts into latency too
 
   PLAT_MUTEX_LOCK(&server->state_mutex);
-  if (server->connfd < 0 || server->stop_requested) {
-    PLAT_MUTEX_UNLOCK(&server->state_mutex);
-    return -WSAT_ERROR_SAT_DISCONNECTED;
-  }
-  connfd = server->connfd;
+  if (server->connfd >= 0 && !server->stop_requested) connfd = server->connfd;
   PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  if (connfd < 0) return false;
 
-  // TODO: Instead of using malloc in cJSON, we can print to our own buffers instead.
+  PLAT_MUTEX_LOCK(&server->send_mutex);
+  server->send_connfd = connfd;
+  server->send_class = send_class;
+  server->send_start_us = start_us;
+  server->send_iov_count = 0;
+  server->send_buffer_used = 0;
+  server->send_result = WSAT_OK;
+  return true;
+}
 
-  char* data_json = NULL;
-  size_t data_json_length = 0;
-  char* header_json = NULL;
-  size_t header_json_length = 0;
-  if (evt == NULL || evt->header == NULL) return -WSAT_ERROR_SOCKET;
-  if (evt->data != NULL) {
-    data_json = cJSON_PrintUnformatted(evt->data);
-    if (data_json == NULL) {
-      ret = -WSAT_ERROR_SOCKET;
-      goto cleanup;
-    }
-    data_json_length = strlen(data_json);
-    cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "data_length");
-    cJSON_AddItemToObject(evt->header, "data_length", cJSON_CreateNumber((double)data_json_length));
-  } else {
-    cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "data_length");
+int32_t wsat_event_batch_end()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  int32_t ret = wsat_event_batch_flush(false);
+  if (server->send_result < 0) ret = server->send_result;
+  PLAT_MUTEX_UNLOCK(&server->send_mutex);
+  return ret;
+}
+
+struct wsat_json_writer* wsat_event_batch_write_begin()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  // Events are placed one after another in send buffer, when it's getting full, the queued ones are sent first.
+  if (server->send_iov_count > 0 && WSAT_SEND_BUFFER_SIZE - server->send_buffer_used < WSAT_SEND_BUFFER_SIZE / 2) {
+    const int32_t res = wsat_event_batch_flush(true);
+    if (res < 0) server->send_result = res;
   }
-  if (evt->payload != NULL) {
-    cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "payload_length");
-    cJSON_AddItemToObject(evt->header, "payload_length", cJSON_CreateNumber(evt->payload_length));
-  } else {
-    cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "payload_length");
+  // Space before data is kept for header, which is known only when data are done
+  wsat_json_writer_init(&server->send_writer, server->send_buffer + server->send_buffer_used + WSAT_SEND_HEADER_MAX_SIZE,
+                        WSAT_SEND_BUFFER_SIZE - server->send_buffer_used - WSAT_SEND_HEADER_MAX_SIZE);
+  return &server->send_writer;
+}
+
+// Queues rendered header, data and payload. Header placed right before data in send buffer goes out
+// together with data as one buffer, data printed elsewhere get their own buffer.
+static int32_t wsat_event_iov_add(const char* header, uint32_t header_length, const char* data, uint32_t data_length,
+                                  const uint8_t* payload, uint32_t payload_length)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  if (server->send_iov_count + 3 > ARRAY_LENGTH(server->send_iov)) {
+    const int32_t res = wsat_event_batch_flush(true);
+    if (res < 0) return res;
   }
-  header_json = cJSON_PrintUnformatted(evt->header);
-  if (header_json == NULL) {
-    ret = -WSAT_ERROR_SOCKET;
-    goto cleanup;
+  const bool is_data_in_buffer = data == server->send_writer.buffer;
+  const bool is_joined = is_data_in_buffer && header + header_length == data;
+  struct iovec* iov = server->send_iov + server->send_iov_count;
+  iov->iov_base = (void*)header;
+  iov->iov_len = header_length + (is_joined ? data_length : 0);
+  iov++;
+  if (!is_joined && data_length > 0) {
+    iov->iov_base = (void*)data;
+    iov->iov_len = data_length;
+    iov++;
   }
-  header_json_length = strlen(header_json);
-  // We are abusing the fact that every string ends with \0
-  header_json[header_json_length] = '\n';
+  if (payload != NULL && payload_length > 0) {
+    iov->iov_base = (void*)payload;
+    iov->iov_len = payload_length;
+    iov++;
+  }
+  server->send_iov_count = iov - server->send_iov;
+  server->send_buffer_used = (server->send_writer.buffer - server->send_buffer) +
+                             (is_data_in_buffer ? data_length : 0);
+  return WSAT_OK;
+}
 
-  PLAT_MUTEX_LOCK(&server->send_mutex);
-  if (wsat_send_all(connfd, (const uint8_t*)header_json, header_json_length + 1, WSAT_SEND_TIMEOUT_MS) < 0) {
-    ret = -WSAT_ERROR_SOCKET;
-    goto send_cleanup;
+// Appends lengths to header template, puts it right before data and queues them together with payload.
+static int32_t wsat_event_queue(const char* header_template, uint32_t header_template_length,
+                                const char* data, uint32_t data_length,
+                                const uint8_t* payload, uint32_t payload_length)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  struct wsat_json_writer header;
+  wsat_json_writer_init(&header, server->send_header, sizeof(server->send_header));
+  wsat_json_writer_raw(&header, header_template, header_template_length);
+  if (data_length > 0) {
+    wsat_json_writer_raw(&header, ",\"data_length\":", 15);
+    wsat_json_writer_uint_value(&header, data_length);
   }
-  if (data_json != NULL) {
-    if (wsat_send_all(connfd, (const uint8_t*)data_json, data_json_length, WSAT_SEND_TIMEOUT_MS) < 0) {
-      ret = -WSAT_ERROR_SOCKET;
-      goto send_cleanup;
-    }
+  if (payload != NULL) {
+    wsat_json_writer_raw(&header, ",\"payload_length\":", 18);
+    wsat_json_writer_uint_value(&header, payload_length);
   }
-  if (evt->payload != NULL && evt->payload_length > 0) {
-    if (wsat_send_all(connfd, evt->payload, evt->payload_length, WSAT_SEND_TIMEOUT_MS) < 0) {
-      ret = -WSAT_ERROR_SOCKET;
-      goto send_cleanup;
+  wsat_json_writer_raw(&header, "}\n", 2);
+  if (header.is_overflow) {
+    LOGE("Event header is too big");
+    return -WSAT_ERROR_EVENT_TOO_BIG;
+  }
+  // Header is always placed into space reserved before data
+  char* header_start = server->send_writer.buffer - header.length;
+  memcpy(header_start, header.buffer, header.length);
+  return wsat_event_iov_add(header_start, header.length, data, data_length, payload, payload_length);
+}
+
+int32_t wsat_event_batch_write_end(const char* header_template, uint32_t header_template_length,
+                                   const uint8_t* payload, uint32_t payload_length)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  struct wsat_json_writer* data = &server->send_writer;
+  int32_t ret;
+  if (data->is_overflow) {
+    LOGE("Event data doesn't fit into send buffer");
+    ret = -WSAT_ERROR_EVENT_TOO_BIG;
+  } else {
+    ret = wsat_event_queue(header_template, header_template_length, data->buffer, data->length,
+                           payload, payload_length);
+  }
+  if (ret < 0) server->send_result = ret;
+  return ret;
+}
+
+// Queues event with data rendered elsewhere, which must stay valid until wsat_event_batch_end
+int32_t wsat_event_batch_write_data(const char* header_template, uint32_t header_template_length,
+                                    const char* data, uint32_t data_length)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  wsat_event_batch_write_begin(); // Reserves space for header
+  const int32_t ret = wsat_event_queue(header_template, header_template_length, data, data_length, NULL, 0);
+  if (ret < 0) server->send_result = ret;
+  return ret;
+}
+
+struct wsat_json_writer* wsat_event_write_begin(enum wsat_send_class send_class)
+{
+  if (!wsat_event_batch_begin(send_class)) return NULL;
+  return wsat_event_batch_write_begin();
+}
+
+int32_t wsat_event_write_end(const char* header_template, uint32_t header_template_length,
+                             const uint8_t* payload, uint32_t payload_length)
+{
+  wsat_event_batch_write_end(header_template, header_template_length, payload, payload_length);
+  return wsat_event_batch_end();
+}
+
+int32_t wsat_event_send(struct wsat_event* evt)
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  int32_t ret = WSAT_OK;
+
+  if (evt == NULL || evt->header == NULL) return -WSAT_ERROR_SOCKET;
+  // Lengths are appended when sending
+  cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "data_length");
+  cJSON_DeleteItemFromObjectCaseSensitive(evt->header, "payload_length");
+
+  // Events of user carrying payload are most likely audio, everything else is treated as control event
+  const enum wsat_send_class send_class = evt->payload != NULL ? WSAT_SEND_CLASS_BULK : WSAT_SEND_CLASS_CONTROL;
+  if (wsat_event_write_begin(send_class) == NULL) return -WSAT_ERROR_SAT_DISCONNECTED;
+  // Both are printed into our buffers, cJSON allocator is used only for data too big for send buffer.
+  char* data_json = NULL;
+  uint32_t data_json_length = 0;
+  char* data_json_allocated = NULL;
+  char* header_json = server->send_header;
+  char* header_json_allocated = NULL;
+  if (evt->data != NULL) {
+    data_json = server->send_writer.buffer;
+    // cJSON needs few bytes more than it really prints
+    if (!cJSON_PrintPreallocated(evt->data, data_json, (int)server->send_writer.capacity, false)) {
+      data_json = data_json_allocated = cJSON_PrintUnformatted(evt->data);
+      if (data_json == NULL) {
+        ret = -WSAT_ERROR_EVENT_TOO_BIG;
+        goto cleanup;
+      }
     }
+    data_json_length = strlen(data_json);
   }
-send_cleanup:
-  PLAT_MUTEX_UNLOCK(&server->send_mutex);
+  // Header is printed into scratch buffer first, and its closing `}` is replaced by lengths, which must fit too.
+  static const char lengths_max[] = ",\"data_length\":4294967295,\"payload_length\":4294967295}\n";
+  if (cJSON_PrintPreallocated(evt->header, header_json, WSAT_SEND_HEADER_MAX_SIZE - (sizeof(lengths_max) - 1),
+                              false)) {
+    const uint32_t header_json_length = strlen(header_json);
+    // Template is copied, as header is rendered into the same scratch buffer
+    char header_template[WSAT_SEND_HEADER_MAX_SIZE];
+    memcpy(header_template, header_json, header_json_length - 1);
+    ret = wsat_event_queue(header_template, header_json_length - 1, data_json, data_json_length,
+                           evt->payload, evt->payload_length);
+    goto cleanup;
+  }
+  // Header too big for the space before data is printed with lengths by cJSON allocator, and sent on its own
+  if (evt->data != NULL) cJSON_AddNumberToObject(evt->header, "data_length", data_json_length);
+  if (evt->payload != NULL) cJSON_AddNumberToObject(evt->header, "payload_length", evt->payload_length);
+  header_json_allocated = cJSON_PrintUnformatted(evt->header);
+  if (header_json_allocated == NULL) {
+    LOGE("Event header is too big");
+    ret = -WSAT_ERROR_EVENT_TOO_BIG;
+    goto cleanup;
+  }
+  const uint32_t header_json_length = strlen(header_json_allocated);
+  header_json_allocated[header_json_length] = '\n'; // String terminator is not sent, so it's replaced by newline
+  ret = wsat_event_iov_add(header_json_allocated, header_json_length + 1, data_json, data_json_length,
+                           evt->payload, evt->payload_length);
 cleanup:
-  free(header_json);
-  if (data_json != NULL) free(data_json);
+  if (ret < 0) server->send_result = ret;
+  ret = wsat_event_batch_end();
+  // Printed with cJSON allocator, which might be arena
+  if (data_json_allocated != NULL) cJSON_free(data_json_allocated);
+  if (header_json_allocated != NULL) cJSON_free(header_json_allocated);
   return ret;
 }
 
@@ -0,0 +1,344 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Transports carry the stream of events, server only calls functions of the selected one.
+ * Socket transports (TCP and Unix domain socket) share everything except listening, handles are file descriptors.
+ * Waiting is done by poll() together with wakeup channel, so stop request wakes any wait up.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "satellite_priv.h"
+
+#if WSAT_WAKEUP == WSAT_WAKEUP_EVENTFD
+#include <sys/eventfd.h>
+#elif WSAT_WAKEUP == WSAT_WAKEUP_PIPE
+#include <fcntl.h>
+#endif
+
+#if WSAT_TRANSPORT_UNIX
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Tells kernel that more data follow, so they can share packets, where it's supported
+#ifndef MSG_MORE
+#define MSG_MORE 0
+#endif
+
+// Socket stays blocking for reads, sends don't block, so stop request is noticed while waiting for space
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0
+#endif
+
+// Both ends are non-blocking, so signaled channel can be drained without knowing how many times it was signaled
+void wsat_wakeup_create(int fds[2])
+{
+  fds[0] = fds[1] = -1;
+#if WSAT_WAKEUP == WSAT_WAKEUP_EVENTFD
+  fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK);
+#elif WSAT_WAKEUP == WSAT_WAKEUP_PIPE
+  if (pipe(fds) < 0) {
+    fds[0] = fds[1] = -1;
+  } else {
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+  }
+#elif WSAT_WAKEUP == WSAT_WAKEUP_PLATFORM
+  if (PLAT_WAKEUP_CREATE(fds) < 0) fds[0] = fds[1] = -1;
+#endif
+}
+
+void wsat_wakeup_destroy(int fds[2])
+{
+  if (fds[0] >= 0) close(fds[0]);
+  if (fds[1] >= 0 && fds[1] != fds[0]) close(fds[1]);
+  fds[0] = fds[1] = -1;
+}
+
+void wsat_wakeup_signal(int fd)
+{
+  const uint64_t value = 1; // eventfd takes exactly 8 bytes, pipe and sockets take anything
+  while (write(fd, &value, sizeof(value)) < 0 && errno == EINTR);
+}
+
+void wsat_wakeup_clear(int fd)
+{
+  uint64_t values[8];
+  while (true) {
+    const ssize_t res = read(fd, values, sizeof(values));
+    if (res <= 0 && !(res < 0 && errno == EINTR)) break;
+  }
+}
+
+// Waits until `fd` has `events` or `wakeup_fd` is readable, returns 1 when `fd` is ready
+int wsat_transport_poll(int fd, short events, int wakeup_fd, int32_t timeout_ms)
+{
+  struct pollfd fds[2];
+  nfds_t fd_count = 1;
+  fds[0].fd = fd;
+  fds[0].events = events;
+  fds[0].revents = 0;
+  if (wakeup_fd >= 0) {
+    fds[1].fd = wakeup_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    fd_count++;
+  }
+  const int res = poll(fds, fd_count, timeout_ms < 0 ? -1 : (int)timeout_ms);
+  if (res <= 0) return res;
+  // Errors and hang-ups are reported as ready, so the following call sees them
+  return fds[0].revents != 0 ? 1 : 0;
+}
+
+// Buffer sizes are set on listening socket, so the connection gets them from the start (TCP window scale
+// is negotiated during handshake), accepted sockets inherit them.
+static int wsat_socket_listen(int sockfd, const struct sockaddr* addr, socklen_t addr_length,
+                              const struct wsat_config* config)
+{
+  const int enable = 1;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0) {
+    LOGE("setsockopt(SO_REUSEADDR) failed");
+    close(sockfd);
+    return -1;
+  }
+  const int send_buffer_size = (int)config->send_buffer_size;
+  if (send_buffer_size > 0 && setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &send_buffer_size, sizeof(int)) < 0) {
+    LOGE("setsockopt(SO_SNDBUF) failed");
+  }
+  const int receive_buffer_size = (int)config->receive_buffer_size;
+  if (receive_buffer_size > 0 &&
+      setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(int)) < 0) {
+    LOGE("setsockopt(SO_RCVBUF) failed");
+  }
+  if (bind(sockfd, addr, addr_length) < 0) {
+    LOGE("bind() failed, err: %d", errno);
+    close(sockfd);
+    return -1;
+  }
+  if (listen(sockfd, 1) < 0) {
+    LOGE("listen() failed, err: %d", errno);
+    close(sockfd);
+    return -1;
+  }
+  return sockfd;
+}
+
+static int wsat_tcp_listen(const struct wsat_config* config)
+{
+  struct sockaddr_storage serv_addr;
+  socklen_t serv_addr_length;
+  memset((char*)&serv_addr, 0, sizeof(serv_addr));
+  if (config->is_ipv6) {
+    struct sockaddr_in6* addr = (struct sockaddr_in6*)&serv_addr;
+    addr->sin6_family = AF_INET6;
+    addr->sin6_port = htons(config->port);
+    addr->sin6_addr = in6addr_any;
+    serv_addr_length = sizeof(*addr);
+    if (config->address != NULL && inet_pton(AF_INET6, config->address, &addr->sin6_addr) != 1) {
+      LOGE("Invalid IPv6 address \"%s\"", config->address);
+      return -1;
+    }
+  } else {
+    struct sockaddr_in* addr = (struct sockaddr_in*)&serv_addr;
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(config->port);
+    addr->sin_addr.s_addr = htonl(INADDR_ANY);
+    serv_addr_length = sizeof(*addr);
+    if (config->address != NULL && inet_pton(AF_INET, config->address, &addr->sin_addr) != 1) {
+      LOGE("Invalid IPv4 address \"%s\"", config->address);
+      return -1;
+    }
+  }
+  const int sockfd = socket(serv_addr.ss_family, SOCK_STREAM, 0);
+  if (sockfd < 0) {
+    LOGE("socket() failed");
+    return -1;
+  }
+#ifdef IPV6_V6ONLY
+  if (config->is_ipv6 && config->address == NULL) {
+    // Any address takes IPv4 too, which is not the default everywhere
+    const int disable = 0;
+    setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(int));
+  }
+#endif
+  if (wsat_socket_listen(sockfd, (struct sockaddr*)&serv_addr, serv_addr_length, config) < 0) return -1;
+  // Port 0 in config is picked by system
+  uint16_t port = config->port;
+  serv_addr_length = sizeof(serv_addr);
+  if (getsockname(sockfd, (struct sockaddr*)&serv_addr, &serv_addr_length) == 0) {
+    port = ntohs(serv_addr.ss_family == AF_INET6 ? ((struct sockaddr_in6*)&serv_addr)->sin6_port
+                                                 : ((struct sockaddr_in*)&serv_addr)->sin_port);
+  }
+  LOGD("Server listening on %s port %d", config->address != NULL ? config->address : "any address", port);
+  return sockfd;
+}
+
+static int wsat_socket_accept(int listener, const struct wsat_config* config)
+{
+  (void)config;
+  return accept(listener, NULL, NULL);
+}
+
+// Options of the connection itself are set on accepted socket, not all systems inherit them from listener
+static void wsat_tcp_options_set(int fd, const struct wsat_config* config)
+{
+#ifdef TCP_NODELAY
+  const int nodelay = config->is_nodelay ? 1 : 0;
+  if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(int)) < 0) LOGE("setsockopt(TCP_NODELAY) failed");
+#endif
+#ifdef TCP_USER_TIMEOUT
+  // Unacknowledged data don't keep dead connection around for minutes of retransmissions
+  const int user_timeout_ms = (int)config->peer_timeout_s * 1000;
+  if (user_timeout_ms > 0 && setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout_ms, sizeof(int)) < 0) {
+    LOGE("setsockopt(TCP_USER_TIMEOUT) failed");
+  }
+#endif
+  // Without keepalive in config, idle connection is probed in the first half of peer timeout, three probes in the second
+  const uint32_t peer_timeout_s = config->peer_timeout_s;
+  const bool is_derived = config->keepalive_idle_s == 0 && peer_timeout_s > 0;
+  const uint32_t idle_s = is_derived ? (peer_timeout_s / 2 > 0 ? peer_timeout_s / 2 : 1) : config->keepalive_idle_s;
+  if (idle_s == 0) return;
+  const int enable = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(int)) < 0) {
+    LOGE("setsockopt(SO_KEEPALIVE) failed");
+    return;
+  }
+#if defined(TCP_KEEPIDLE)
+  const int idle = (int)idle_s;
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(int));
+#elif defined(TCP_KEEPALIVE)
+  const int idle = (int)idle_s;
+  setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, &idle, sizeof(int)); // Same option on Apple systems
+#endif
+#ifdef TCP_KEEPINTVL
+  const int interval = is_derived ? (peer_timeout_s / 6 > 0 ? (int)peer_timeout_s / 6 : 1)
+                                  : (int)config->keepalive_interval_s;
+  if (interval > 0) setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(int));
+#endif
+#ifdef TCP_KEEPCNT
+  const int probe_count = is_derived ? 3 : (int)config->keepalive_count;
+  if (probe_count > 0) setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &probe_count, sizeof(int));
+#endif
+}
+
+static int wsat_tcp_accept(int listener, const struct wsat_config* config)
+{
+  const int connfd = accept(listener, NULL, NULL);
+  if (connfd >= 0) wsat_tcp_options_set(connfd, config);
+  return connfd;
+}
+
+static int32_t wsat_socket_read(int conn, struct iovec* iov, uint32_t iov_count)
+{
+  return (int32_t)readv(conn, iov, (int)iov_count);
+}
+
+static int32_t wsat_socket_writev(int conn, struct iovec* iov, uint32_t iov_count, bool is_more)
+{
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iov_count;
+  return (int32_t)sendmsg(conn, &msg, (is_more ? MSG_MORE : 0) | MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static int wsat_socket_wait(int handle, bool is_write, int wakeup_fd, int32_t timeout_ms)
+{
+  return wsat_transport_poll(handle, is_write ? POLLOUT : POLLIN, wakeup_fd, timeout_ms);
+}
+
+static void wsat_socket_shutdown(int conn)
+{
+  shutdown(conn, SHUT_RDWR);
+}
+
+static void wsat_socket_close(int handle)
+{
+  close(handle);
+}
+
+// Both are sampled only where the platform tells them, otherwise they stay 0
+static void wsat_socket_backlog(int conn, uint32_t* queued_bytes, uint32_t* rtt_us)
+{
+#if defined(SIOCOUTQ) || defined(TIOCOUTQ)
+  // Bytes written into socket, which were not acknowledged by server yet
+  int socket_queued = 0;
+#if defined(SIOCOUTQ)
+  if (ioctl(conn, SIOCOUTQ, &socket_queued) == 0 && socket_queued > 0) *queued_bytes = socket_queued;
+#else
+  if (ioctl(conn, TIOCOUTQ, &socket_queued) == 0 && socket_queued > 0) *queued_bytes = socket_queued;
+#endif
+#endif
+#if defined(TCP_INFO) && defined(__linux__)
+  struct tcp_info info;
+  socklen_t info_length = sizeof(info);
+  if (getsockopt(conn, IPPROTO_TCP, TCP_INFO, &info, &info_length) == 0) *rtt_us = info.tcpi_rtt;
+#endif
+}
+
+const struct wsat_transport wsat_transport_tcp = {
+  "tcp",
+  wsat_tcp_listen,
+  wsat_tcp_accept,
+  wsat_socket_read,
+  wsat_socket_writev,
+  wsat_socket_wait,
+  wsat_socket_shutdown,
+  wsat_socket_close,
+  wsat_socket_backlog,
+};
+
+#if WSAT_TRANSPORT_UNIX
+
+// Address is path of the socket, port is not used. Socket left by previous run is removed first.
+static int wsat_unix_listen(const struct wsat_config* config)
+{
+  struct sockaddr_un serv_addr;
+  const char* path = config->address != NULL ? config->address : WSAT_TRANSPORT_UNIX_PATH;
+  if (strlen(path) >= sizeof(serv_addr.sun_path)) {
+    LOGE("Socket path \"%s\" is too long", path);
+    return -1;
+  }
+  const int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sockfd < 0) {
+    LOGE("socket() failed");
+    return -1;
+  }
+  memset((char*)&serv_addr, 0, sizeof(serv_addr));
+  serv_addr.sun_family = AF_UNIX;
+  strcpy(serv_addr.sun_path, path);
+  // Socket left by previous run would fail the bind, anything else at the path is not ours to remove
+  struct stat path_stat;
+  if (lstat(path, &path_stat) == 0) {
+    if (!S_ISSOCK(path_stat.st_mode)) {
+      LOGE("\"%s\" exists and is not a socket", path);
+      close(sockfd);
+      return -1;
+    }
+    unlink(path);
+  }
+  if (wsat_socket_listen(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr), config) < 0) return -1;
+  LOGD("Server listening on \"%s\"", path);
+  return sockfd;
+}
+
+const struct wsat_transport wsat_transport_unix = {
+  "unix",
+  wsat_unix_listen,
+  wsat_socket_accept,
+  wsat_socket_read,
+  wsat_socket_writev,
+  wsat_socket_wait,
+  wsat_socket_shutdown,
+  wsat_socket_close,
+  wsat_socket_backlog,
+};
+
+#endif
@@ -0,0 +1,358 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * In-process transport, client in the same process connects with wsat_transport_loopback_connect
+ * and talks to the server through two rings in memory, one for each direction.
+ * There is only one connection at a time, handles are fixed: listener, server end and client end.
+ * Every ring has wakeup channels telling there are data to read and space to write, so waiting is still done
+ * by poll() together with the stop request.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "satellite_priv.h"
+
+#if WSAT_WAKEUP != WSAT_WAKEUP_NONE
+
+#define WSAT_LOOPBACK_LISTENER (0)
+#define WSAT_LOOPBACK_SERVER (1)
+#define WSAT_LOOPBACK_CLIENT (2)
+
+// Channel, which is readable as long as its condition holds
+struct wsat_loopback_level
+{
+  int fds[2];
+  bool is_signaled;
+};
+
+struct wsat_loopback_ring
+{
+  uint8_t buffer[WSAT_TRANSPORT_LOOPBACK_SIZE];
+  uint32_t head; // Offset of the first byte to be read
+  uint32_t used;
+  bool is_writer_closed; // Reader gets 0, once everything is read
+  bool is_reader_closed; // Writer gets EPIPE
+  struct wsat_loopback_level data; // Something to read, or writer is gone
+  struct wsat_loopback_level space; // Space to write, or reader is gone
+};
+
+static struct wsat_loopback
+{
+  bool is_mutex_created; // Mutex is created by first listen and stays, so client can check for server anytime
+  PLAT_MUTEX_TYPE mutex;
+  bool is_open[3]; // Indexed by handle
+  bool is_pending; // Client connected, but was not accepted yet
+  struct wsat_loopback_level accept;
+  struct wsat_loopback_ring rings[2]; // To server, to client
+} wsat_loopback;
+
+static void wsat_loopback_level_set(struct wsat_loopback_level* level, bool is_ready)
+{
+  if (is_ready && !level->is_signaled) wsat_wakeup_signal(level->fds[1]);
+  if (!is_ready && level->is_signaled) wsat_wakeup_clear(level->fds[0]);
+  level->is_signaled = is_ready;
+}
+
+static void wsat_loopback_ring_update(struct wsat_loopback_ring* ring)
+{
+  wsat_loopback_level_set(&ring->data, ring->used > 0 || ring->is_writer_closed);
+  wsat_loopback_level_set(&ring->space, ring->used < sizeof(ring->buffer) || ring->is_reader_closed);
+}
+
+static void wsat_loopback_ring_reset(struct wsat_loopback_ring* ring)
+{
+  ring->head = 0;
+  ring->used = 0;
+  ring->is_writer_closed = false;
+  ring->is_reader_closed = false;
+  wsat_loopback_ring_update(ring);
+}
+
+static void wsat_loopback_ring_close(struct wsat_loopback_ring* ring)
+{
+  ring->is_writer_closed = true;
+  ring->is_reader_closed = true;
+  wsat_loopback_ring_update(ring);
+}
+
+static struct wsat_loopback_level* wsat_loopback_levels[] = {
+  &wsat_loopback.accept,
+  &wsat_loopback.rings[0].data, &wsat_loopback.rings[0].space,
+  &wsat_loopback.rings[1].data, &wsat_loopback.rings[1].space,
+};
+
+// Channels are released, once all handles are closed
+static void wsat_loopback_release()
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  if (loop->is_open[WSAT_LOOPBACK_LISTENER] || loop->is_open[WSAT_LOOPBACK_SERVER] ||
+      loop->is_open[WSAT_LOOPBACK_CLIENT]) {
+    return;
+  }
+  for (uint32_t i = 0; i < ARRAY_LENGTH(wsat_loopback_levels); i++) {
+    wsat_wakeup_destroy(wsat_loopback_levels[i]->fds);
+    wsat_loopback_levels[i]->is_signaled = false;
+  }
+}
+
+static bool wsat_loopback_is_conn(int conn)
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  if ((conn != WSAT_LOOPBACK_SERVER && conn != WSAT_LOOPBACK_CLIENT) || !loop->is_open[conn]) {
+    errno = EBADF;
+    return false;
+  }
+  return true;
+}
+
+static struct wsat_loopback_ring* wsat_loopback_ring_in(int conn)
+{
+  return &wsat_loopback.rings[conn == WSAT_LOOPBACK_SERVER ? 0 : 1];
+}
+
+static struct wsat_loopback_ring* wsat_loopback_ring_out(int conn)
+{
+  return &wsat_loopback.rings[conn == WSAT_LOOPBACK_SERVER ? 1 : 0];
+}
+
+static int wsat_loopback_listen(const struct wsat_config* config)
+{
+  (void)config;
+  struct wsat_loopback* loop = &wsat_loopback;
+  int ret = WSAT_LOOPBACK_LISTENER;
+  if (!loop->is_mutex_created) {
+    PLAT_MUTEX_CREATE(&loop->mutex); // TODO: Error check
+    loop->is_mutex_created = true;
+  }
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (loop->is_open[WSAT_LOOPBACK_LISTENER] || loop->is_open[WSAT_LOOPBACK_SERVER] ||
+      loop->is_open[WSAT_LOOPBACK_CLIENT]) {
+    LOGE("Loopback is already in use");
+    errno = EADDRINUSE;
+    ret = -1;
+    goto cleanup;
+  }
+  for (uint32_t i = 0; i < ARRAY_LENGTH(wsat_loopback_levels); i++) {
+    wsat_wakeup_create(wsat_loopback_levels[i]->fds);
+    wsat_loopback_levels[i]->is_signaled = false;
+    if (wsat_loopback_levels[i]->fds[0] < 0) {
+      LOGE("Loopback channels couldn't be created");
+      wsat_loopback_release();
+      ret = -1;
+      goto cleanup;
+    }
+  }
+  loop->is_pending = false;
+  wsat_loopback_ring_reset(&loop->rings[0]);
+  wsat_loopback_ring_reset(&loop->rings[1]);
+  loop->is_open[WSAT_LOOPBACK_LISTENER] = true;
+  LOGD("Server listening on loopback");
+cleanup:
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  return ret;
+}
+
+int wsat_transport_loopback_connect()
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  int ret = WSAT_LOOPBACK_CLIENT;
+  if (!loop->is_mutex_created) {
+    errno = ECONNREFUSED;
+    return -1;
+  }
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (!loop->is_open[WSAT_LOOPBACK_LISTENER] || loop->is_pending || loop->is_open[WSAT_LOOPBACK_SERVER] ||
+      loop->is_open[WSAT_LOOPBACK_CLIENT]) {
+    errno = ECONNREFUSED; // Only one connection at a time
+    ret = -1;
+    goto cleanup;
+  }
+  wsat_loopback_ring_reset(&loop->rings[0]);
+  wsat_loopback_ring_reset(&loop->rings[1]);
+  loop->is_open[WSAT_LOOPBACK_CLIENT] = true;
+  loop->is_pending = true;
+  wsat_loopback_level_set(&loop->accept, true);
+cleanup:
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  return ret;
+}
+
+static int wsat_loopback_accept(int listener, const struct wsat_config* config)
+{
+  (void)config;
+  struct wsat_loopback* loop = &wsat_loopback;
+  int ret = WSAT_LOOPBACK_SERVER;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (listener != WSAT_LOOPBACK_LISTENER || !loop->is_open[WSAT_LOOPBACK_LISTENER]) {
+    errno = EBADF;
+    ret = -1;
+  } else if (!loop->is_pending) {
+    errno = EAGAIN;
+    ret = -1;
+  } else {
+    loop->is_pending = false;
+    wsat_loopback_level_set(&loop->accept, false);
+    loop->is_open[WSAT_LOOPBACK_SERVER] = true;
+  }
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  return ret;
+}
+
+static int32_t wsat_loopback_read(int conn, struct iovec* iov, uint32_t iov_count)
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  int32_t ret = 0;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (!wsat_loopback_is_conn(conn)) {
+    ret = -1;
+    goto cleanup;
+  }
+  struct wsat_loopback_ring* ring = wsat_loopback_ring_in(conn);
+  if (ring->used == 0) {
+    if (!ring->is_writer_closed) {
+      errno = EAGAIN;
+      ret = -1;
+    }
+    goto cleanup;
+  }
+  for (uint32_t i = 0; i < iov_count && ring->used > 0; i++) {
+    uint8_t* data = iov[i].iov_base;
+    size_t length = iov[i].iov_len < ring->used ? iov[i].iov_len : ring->used;
+    while (length > 0) {
+      // Ring wraps around, so it's read in up to two parts
+      uint32_t part = sizeof(ring->buffer) - ring->head;
+      if (part > length) part = length;
+      memcpy(data, ring->buffer + ring->head, part);
+      ring->head = (ring->head + part) % sizeof(ring->buffer);
+      ring->used -= part;
+      data += part;
+      length -= part;
+      ret += part;
+    }
+  }
+  wsat_loopback_ring_update(ring);
+cleanup:
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  return ret;
+}
+
+static int32_t wsat_loopback_writev(int conn, struct iovec* iov, uint32_t iov_count, bool is_more)
+{
+  (void)is_more; // Reader gets bytes as soon as they are written, nothing to hold back
+  struct wsat_loopback* loop = &wsat_loopback;
+  int32_t ret = 0;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (!wsat_loopback_is_conn(conn)) {
+    ret = -1;
+    goto cleanup;
+  }
+  struct wsat_loopback_ring* ring = wsat_loopback_ring_out(conn);
+  if (ring->is_reader_closed) {
+    errno = EPIPE;
+    ret = -1;
+    goto cleanup;
+  }
+  if (ring->used == sizeof(ring->buffer)) {
+    errno = EAGAIN;
+    ret = -1;
+    goto cleanup;
+  }
+  for (uint32_t i = 0; i < iov_count && ring->used < sizeof(ring->buffer); i++) {
+    const uint8_t* data = iov[i].iov_base;
+    const uint32_t free_length = sizeof(ring->buffer) - ring->used;
+    size_t length = iov[i].iov_len < free_length ? iov[i].iov_len : free_length;
+    while (length > 0) {
+      const uint32_t tail = (ring->head + ring->used) % sizeof(ring->buffer);
+      uint32_t part = sizeof(ring->buffer) - tail;
+      if (part > length) part = length;
+      memcpy(ring->buffer + tail, data, part);
+      ring->used += part;
+      data += part;
+      length -= part;
+      ret += part;
+    }
+  }
+  wsat_loopback_ring_update(ring);
+cleanup:
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  return ret;
+}
+
+static int wsat_loopback_wait(int handle, bool is_write, int wakeup_fd, int32_t timeout_ms)
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  int fd = -1;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (handle == WSAT_LOOPBACK_LISTENER && loop->is_open[handle]) {
+    fd = loop->accept.fds[0];
+  } else if (wsat_loopback_is_conn(handle)) {
+    fd = is_write ? wsat_loopback_ring_out(handle)->space.fds[0] : wsat_loopback_ring_in(handle)->data.fds[0];
+  }
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return wsat_transport_poll(fd, POLLIN, wakeup_fd, timeout_ms);
+}
+
+static void wsat_loopback_shutdown(int conn)
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (wsat_loopback_is_conn(conn)) {
+    wsat_loopback_ring_close(&loop->rings[0]);
+    wsat_loopback_ring_close(&loop->rings[1]);
+  }
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+}
+
+static void wsat_loopback_close(int handle)
+{
+  struct wsat_loopback* loop = &wsat_loopback;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (handle == WSAT_LOOPBACK_LISTENER && loop->is_open[handle]) {
+    loop->is_open[handle] = false;
+    if (loop->is_pending) {
+      // Client, which was never accepted, is disconnected
+      loop->is_pending = false;
+      wsat_loopback_ring_close(&loop->rings[0]);
+      wsat_loopback_ring_close(&loop->rings[1]);
+    }
+    wsat_loopback_release();
+  } else if (wsat_loopback_is_conn(handle)) {
+    loop->is_open[handle] = false;
+    if (loop->is_pending) {
+      loop->is_pending = false;
+      wsat_loopback_level_set(&loop->accept, false);
+    }
+    wsat_loopback_ring_close(&loop->rings[0]);
+    wsat_loopback_ring_close(&loop->rings[1]);
+    wsat_loopback_release();
+  }
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+}
+
+static void wsat_loopback_backlog(int conn, uint32_t* queued_bytes, uint32_t* rtt_us)
+{
+  (void)rtt_us; // No round trip in process, left as caller set it
+  struct wsat_loopback* loop = &wsat_loopback;
+  PLAT_MUTEX_LOCK(&loop->mutex);
+  if (wsat_loopback_is_conn(conn)) *queued_bytes = wsat_loopback_ring_out(conn)->used;
+  PLAT_MUTEX_UNLOCK(&loop->mutex);
+}
+
+const struct wsat_transport wsat_transport_loopback = {
+  "loopback",
+  wsat_loopback_listen,
+  wsat_loopback_accept,
+  wsat_loopback_read,
+  wsat_loopback_writev,
+  wsat_loopback_wait,
+  wsat_loopback_shutdown,
+  wsat_loopback_close,
+  wsat_loopback_backlog,
+};
+
+#endif
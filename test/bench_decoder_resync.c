@@ -0,0 +1,148 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Measures how the decoder recovers from corrupted streams.
+ * Synthetic stream of audio-chunk events, each carrying its sequence number in data, gets random bytes
+ * overwritten at given rate. Events hit by corruption may be lost, but every other lost event is collateral loss,
+ * which means the decoder didn't find its way back to the stream in time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "satellite_priv.h"
+
+#define BENCH_EVENTS 20000
+#define BENCH_PAYLOAD_MAX 2048
+#define BENCH_READ_SIZE 1024
+
+struct bench_event_range
+{
+  uint32_t start;
+  uint32_t end;
+  bool is_corrupted;
+  bool is_decoded;
+};
+
+static uint8_t* stream;
+static uint32_t stream_length;
+static struct bench_event_range events[BENCH_EVENTS];
+
+static uint64_t bench_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_stream_build()
+{
+  const uint32_t capacity = BENCH_EVENTS * (BENCH_PAYLOAD_MAX + 256);
+  stream = malloc(capacity);
+  stream_length = 0;
+  srand(1);
+  for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+    char data[64];
+    const uint32_t data_length = snprintf(data, sizeof(data), "{\"seq\":%u,\"rate\":16000,\"width\":2}", i);
+    const uint32_t payload_length = i % 5 == 0 ? 0 : 256 + rand() % (BENCH_PAYLOAD_MAX - 256);
+    events[i].start = stream_length;
+    stream_length += snprintf((char*)stream + stream_length, capacity - stream_length,
+                              "{\"type\":\"audio-chunk\",\"data_length\":%u,\"payload_length\":%u}\n",
+                              data_length, payload_length);
+    memcpy(stream + stream_length, data, data_length);
+    stream_length += data_length;
+    for (uint32_t j = 0; j < payload_length; j++) stream[stream_length + j] = (uint8_t)rand();
+    stream_length += payload_length;
+    events[i].end = stream_length;
+  }
+}
+
+// Overwrites runs of 1-16 bytes at random positions and marks events they hit.
+// Returns copy of the stream, original stays clean for next run.
+static uint8_t* bench_stream_corrupt(uint32_t corruption_count)
+{
+  uint8_t* corrupted = malloc(stream_length);
+  memcpy(corrupted, stream, stream_length);
+  for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+    events[i].is_corrupted = false;
+    events[i].is_decoded = false;
+  }
+  srand(corruption_count);
+  for (uint32_t i = 0; i < corruption_count; i++) {
+    const uint32_t position = ((uint32_t)rand() * RAND_MAX + rand()) % stream_length;
+    const uint32_t length = 1 + rand() % 16;
+    for (uint32_t j = position; j < position + length && j < stream_length; j++) corrupted[j] = (uint8_t)rand();
+    // Corruption can span more events, find all of them
+    uint32_t lo = 0, hi = BENCH_EVENTS;
+    while (lo + 1 < hi) {
+      const uint32_t mid = (lo + hi) / 2;
+      if (events[mid].start <= position) lo = mid;
+      else hi = mid;
+    }
+    for (uint32_t e = lo; e < BENCH_EVENTS && events[e].start < position + length; e++) events[e].is_corrupted = true;
+  }
+  return corrupted;
+}
+
+static void bench_decoder(struct wsat_event_decoder* dec, const uint8_t* data)
+{
+  struct wsat_decoded_event* evt;
+  wsat_event_decoder_reset(dec);
+  uint32_t offset = 0;
+  while (offset < stream_length) {
+    struct wsat_buffer_region regions[2];
+    const uint32_t region_count = wsat_event_decoder_buffer_get(dec, regions);
+    const uint32_t left = stream_length - offset;
+    const uint32_t read_size = left < BENCH_READ_SIZE ? left : BENCH_READ_SIZE;
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < region_count && written < read_size; i++) {
+      const uint32_t length = regions[i].length < read_size - written ? regions[i].length : read_size - written;
+      memcpy(regions[i].data, data + offset + written, length);
+      written += length;
+    }
+    wsat_event_decoder_buffer_advance(dec, written);
+    offset += written;
+    while (wsat_event_decoder_next(dec, &evt) == 1) {
+      if (evt->flags & WSAT_DECODED_EVENT_FLAG_BEGIN) {
+        cJSON* seq = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "seq");
+        if (cJSON_IsNumber(seq) && seq->valueint >= 0 && seq->valueint < BENCH_EVENTS) {
+          events[seq->valueint].is_decoded = true;
+        }
+      }
+      if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) wsat_decoded_event_free(evt);
+    }
+  }
+}
+
+int main()
+{
+  static const uint32_t corruption_counts[] = { 0, 1, 10, 100, 1000 };
+  static struct wsat_event_decoder dec;
+  bench_stream_build();
+  printf("Stream: %u events, %u bytes, read by %u bytes\n", BENCH_EVENTS, stream_length, BENCH_READ_SIZE);
+  printf("%12s %10s %10s %12s %10s %14s %10s\n",
+         "corruptions", "hit", "lost", "collateral", "resyncs", "skipped/resync", "MB/s");
+  for (uint32_t i = 0; i < ARRAY_LENGTH(corruption_counts); i++) {
+    uint8_t* corrupted = bench_stream_corrupt(corruption_counts[i]);
+    const struct wsat_decoder_stats stats_before = dec.stats;
+    const uint64_t start = bench_time_ns();
+    bench_decoder(&dec, corrupted);
+    const double elapsed_s = (bench_time_ns() - start) / 1e9;
+    uint32_t hit = 0, lost = 0, collateral = 0;
+    for (uint32_t e = 0; e < BENCH_EVENTS; e++) {
+      hit += events[e].is_corrupted;
+      lost += !events[e].is_decoded;
+      collateral += !events[e].is_decoded && !events[e].is_corrupted;
+    }
+    const uint32_t resyncs = dec.stats.resync_count - stats_before.resync_count;
+    const uint32_t skipped = dec.stats.resync_skipped_bytes - stats_before.resync_skipped_bytes;
+    printf("%12u %10u %10u %12u %10u %14.0f %10.1f\n", corruption_counts[i], hit, lost, collateral, resyncs,
+           resyncs > 0 ? (double)skipped / resyncs : 0.0, stream_length / (1024.0 * 1024.0) / elapsed_s);
+    free(corrupted);
+  }
+  free(stream);
+  return 0;
+}
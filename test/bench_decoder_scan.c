@@ -0,0 +1,99 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Measures how long it takes to decode a header close to EVENT_DECODER_BUFFER_SIZE,
+ * when it arrives split into many small reads.
+ * For comparison, it also measures the previous approach, which searched for the header end
+ * from the start of the buffer after every read.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "satellite_priv.h"
+
+#define BENCH_ITERATIONS 200
+
+static uint8_t header[EVENT_DECODER_BUFFER_SIZE];
+static uint32_t header_length;
+
+static uint64_t bench_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_header_build()
+{
+  const char* prefix = "{\"type\":\"info\",\"data\":{\"pad\":\"";
+  const char* suffix = "\"}}\n";
+  header_length = sizeof(header) - 16;
+  memset(header, 'x', header_length);
+  memcpy(header, prefix, strlen(prefix));
+  memcpy(header + header_length - strlen(suffix), suffix, strlen(suffix));
+}
+
+static uint64_t bench_decoder(uint32_t chunk_size)
+{
+  static struct wsat_event_decoder dec;
+  struct wsat_decoded_event* evt;
+  uint32_t decoded = 0;
+  const uint64_t start = bench_time_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    wsat_event_decoder_reset(&dec);
+    for (uint32_t offset = 0; offset < header_length; offset += chunk_size) {
+      struct wsat_buffer_region regions[2];
+      wsat_event_decoder_buffer_get(&dec, regions);
+      const uint32_t left = header_length - offset;
+      const uint32_t length = left < chunk_size ? left : chunk_size;
+      memcpy(regions[0].data, header + offset, length);
+      wsat_event_decoder_buffer_advance(&dec, length);
+      if (wsat_event_decoder_next(&dec, &evt) == 1) {
+        decoded++;
+        wsat_decoded_event_free(evt);
+      }
+    }
+  }
+  const uint64_t elapsed = bench_time_ns() - start;
+  if (decoded != BENCH_ITERATIONS) printf("Decoded only %u headers!\n", decoded);
+  return elapsed;
+}
+
+// Previous approach, searching for the header end from start of the buffer after every read
+static uint64_t bench_rescan(uint32_t chunk_size)
+{
+  static uint8_t buffer[EVENT_DECODER_BUFFER_SIZE];
+  volatile uint32_t found = 0;
+  const uint64_t start = bench_time_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    uint32_t length = 0;
+    for (uint32_t offset = 0; offset < header_length; offset += chunk_size) {
+      const uint32_t left = header_length - offset;
+      const uint32_t chunk_length = left < chunk_size ? left : chunk_size;
+      memcpy(buffer + length, header + offset, chunk_length);
+      length += chunk_length;
+      if (wsat_find_byte_pair(buffer, length, '{', '"') != NULL &&
+          wsat_find_byte_pair(buffer, length, '}', '\n') != NULL) {
+        found++;
+      }
+    }
+  }
+  return bench_time_ns() - start;
+}
+
+int main()
+{
+  static const uint32_t chunk_sizes[] = { 1, 4, 16, 64, 256, 1024, EVENT_DECODER_BUFFER_SIZE };
+  bench_header_build();
+  printf("Header size: %u bytes, %d iterations\n", header_length, BENCH_ITERATIONS);
+  printf("%10s %22s %22s\n", "chunk", "decoder us/header", "rescan us/header");
+  for (int i = 0; i < ARRAY_LENGTH(chunk_sizes); i++) {
+    const double decoder_us = bench_decoder(chunk_sizes[i]) / 1000.0 / BENCH_ITERATIONS;
+    const double rescan_us = bench_rescan(chunk_sizes[i]) / 1000.0 / BENCH_ITERATIONS;
+    printf("%10u %22.2f %22.2f\n", chunk_sizes[i], decoder_us, rescan_us);
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Measures decoder throughput (MB/s and events/s) when a Wyoming stream is fed in chunks from 1 byte to 64 KB.
+ * The stream is either a recording passed as first argument (raw bytes as received from the server),
+ * or a synthetic session: describe, run-satellite, then TTS audio-start, audio-chunks and audio-stop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "satellite_priv.h"
+
+#define BENCH_STREAM_BYTES (8 * 1024 * 1024) // Stream is repeated until at least this many bytes are decoded
+#define BENCH_SYNTH_CHUNKS 200
+#define BENCH_SYNTH_CHUNK_PAYLOAD 2048
+
+static uint8_t* stream;
+static uint32_t stream_length;
+
+static uint64_t bench_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_stream_append_event(uint32_t* capacity, const char* type, const char* data, uint32_t payload_length)
+{
+  char header[256];
+  const uint32_t data_length = data != NULL ? strlen(data) : 0;
+  uint32_t header_length;
+  if (data_length > 0 && payload_length > 0) {
+    header_length = snprintf(header, sizeof(header), "{\"type\":\"%s\",\"version\":\"1.5.2\",\"data_length\":%u,"
+                             "\"payload_length\":%u}\n", type, data_length, payload_length);
+  } else if (data_length > 0) {
+    header_length = snprintf(header, sizeof(header), "{\"type\":\"%s\",\"version\":\"1.5.2\",\"data_length\":%u}\n",
+                             type, data_length);
+  } else {
+    header_length = snprintf(header, sizeof(header), "{\"type\":\"%s\",\"version\":\"1.5.2\"}\n", type);
+  }
+  const uint32_t needed = stream_length + header_length + data_length + payload_length;
+  if (needed > *capacity) {
+    *capacity = needed * 2;
+    stream = realloc(stream, *capacity);
+  }
+  memcpy(stream + stream_length, header, header_length);
+  stream_length += header_length;
+  if (data_length > 0) memcpy(stream + stream_length, data, data_length);
+  stream_length += data_length;
+  for (uint32_t i = 0; i < payload_length; i++) stream[stream_length + i] = (uint8_t)(i * 31);
+  stream_length += payload_length;
+}
+
+static void bench_stream_synthesize()
+{
+  uint32_t capacity = 0;
+  const char* audio_format = "{\"rate\":22050,\"width\":2,\"channels\":1,\"timestamp\":0}";
+  bench_stream_append_event(&capacity, "describe", NULL, 0);
+  bench_stream_append_event(&capacity, "run-satellite", NULL, 0);
+  bench_stream_append_event(&capacity, "ping", "{\"text\":null}", 0);
+  bench_stream_append_event(&capacity, "audio-start", audio_format, 0);
+  for (int i = 0; i < BENCH_SYNTH_CHUNKS; i++) {
+    bench_stream_append_event(&capacity, "audio-chunk", audio_format, BENCH_SYNTH_CHUNK_PAYLOAD);
+  }
+  bench_stream_append_event(&capacity, "audio-stop", "{\"timestamp\":0}", 0);
+}
+
+static int bench_stream_load(const char* path)
+{
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) return -1;
+  fseek(f, 0, SEEK_END);
+  const long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  stream = malloc(size > 0 ? size : 1);
+  stream_length = fread(stream, 1, size, f);
+  fclose(f);
+  return stream_length == size && size > 0 ? 0 : -1;
+}
+
+// Feeds the stream in chunks of given size, returns count of completed events
+static uint64_t bench_decoder(struct wsat_event_decoder* dec, uint32_t chunk_size, uint32_t repeats)
+{
+  struct wsat_decoded_event* evt;
+  uint64_t events = 0;
+  wsat_event_decoder_reset(dec);
+  for (uint32_t r = 0; r < repeats; r++) {
+    uint32_t offset = 0;
+    while (offset < stream_length) {
+      const uint32_t left = stream_length - offset;
+      uint32_t chunk_left = left < chunk_size ? left : chunk_size;
+      // Chunk bigger than free space in the ring is written in multiple steps, as a socket read would be
+      while (chunk_left > 0) {
+        struct wsat_buffer_region regions[2];
+        const uint32_t region_count = wsat_event_decoder_buffer_get(dec, regions);
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < region_count && written < chunk_left; i++) {
+          const uint32_t length = regions[i].length < chunk_left - written ? regions[i].length : chunk_left - written;
+          memcpy(regions[i].data, stream + offset + written, length);
+          written += length;
+        }
+        wsat_event_decoder_buffer_advance(dec, written);
+        offset += written;
+        chunk_left -= written;
+        while (wsat_event_decoder_next(dec, &evt) == 1) {
+          if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) {
+            events++;
+            wsat_decoded_event_free(evt);
+          }
+        }
+      }
+    }
+  }
+  return events;
+}
+
+int main(int argc, char** argv)
+{
+  static const uint32_t chunk_sizes[] = { 1, 16, 256, 1024, 4096, 16384, 65536 };
+  static struct wsat_event_decoder dec;
+  if (argc > 1) {
+    if (bench_stream_load(argv[1]) != 0) {
+      printf("Failed to load stream from %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    bench_stream_synthesize();
+  }
+  const uint32_t repeats = BENCH_STREAM_BYTES / stream_length + 1;
+  const uint64_t expected_events = bench_decoder(&dec, EVENT_DECODER_BUFFER_SIZE, 1) * repeats;
+  printf("Stream: %s, %u bytes, repeated %u times\n", argc > 1 ? argv[1] : "synthetic", stream_length, repeats);
+  printf("%10s %14s %14s\n", "chunk", "MB/s", "events/s");
+  for (int i = 0; i < ARRAY_LENGTH(chunk_sizes); i++) {
+    const uint64_t start = bench_time_ns();
+    const uint64_t events = bench_decoder(&dec, chunk_sizes[i], repeats);
+    const double elapsed_s = (bench_time_ns() - start) / 1e9;
+    const double mb_per_s = (double)stream_length * repeats / (1024.0 * 1024.0) / elapsed_s;
+    printf("%10u %14.1f %14.0f\n", chunk_sizes[i], mb_per_s, events / elapsed_s);
+    if (events != expected_events) {
+      printf("Decoded %lu events, expected %lu!\n", (unsigned long)events, (unsigned long)expected_events);
+    }
+  }
+  free(stream);
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Measures how long it takes to find handler for decoded event type.
+ * For comparison, it also measures the previous approach, which compared the type with every known type
+ * and then searched list of handlers for the resolved type.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "satellite_priv.h"
+
+#define BENCH_ITERATIONS 2000000
+
+static const char* bench_types[] = {
+  "audio-chunk", "audio-chunk", "audio-chunk", "audio-chunk", "audio-start", "audio-stop",
+  "ping", "describe", "run-satellite", "transcript", "error", "synthesize",
+};
+
+static uint64_t bench_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Previous approach, linear search over types and then over handlers
+struct bench_type_entry
+{
+  const char* type_str;
+  enum wsat_packet_type type_enum;
+};
+
+static const struct bench_type_entry bench_type_map[] = {
+  { "describe",        WSAT_EVENT_TYPE_DESCRIBE },
+  { "ping",            WSAT_EVENT_TYPE_PING },
+  { "run-satellite",   WSAT_EVENT_TYPE_RUN_SATELLITE },
+  { "pause-satellite", WSAT_EVENT_TYPE_PAUSE_SATELLITE },
+  { "audio-start",     WSAT_EVENT_TYPE_AUDIO_START },
+  { "audio-chunk",     WSAT_EVENT_TYPE_AUDIO_CHUNK },
+  { "audio-stop",      WSAT_EVENT_TYPE_AUDIO_STOP },
+  { "detection",       WSAT_EVENT_TYPE_DETECTION },
+  { "voice-stopped",   WSAT_EVENT_TYPE_VOICE_STOPPED },
+  { "error",           WSAT_EVENT_TYPE_ERROR },
+  { "transcript",      WSAT_EVENT_TYPE_TRANSCRIPT },
+};
+
+struct bench_handler_entry
+{
+  enum wsat_packet_type type;
+  wsat_event_handler_fn handler_fn; // Filled from default handlers in main
+};
+
+static struct bench_handler_entry bench_handlers[] = {
+  { WSAT_EVENT_TYPE_DESCRIBE,    NULL },
+  { WSAT_EVENT_TYPE_PING,        NULL },
+  { WSAT_EVENT_TYPE_AUDIO_START, NULL },
+  { WSAT_EVENT_TYPE_AUDIO_CHUNK, NULL },
+  { WSAT_EVENT_TYPE_AUDIO_STOP,  NULL },
+  { WSAT_EVENT_TYPE_ERROR,       NULL },
+};
+
+static wsat_event_handler_fn bench_linear_lookup(const char* type)
+{
+  enum wsat_packet_type packet_type = WSAT_EVENT_TYPE_NONE;
+  for (uint8_t i = 0; i < ARRAY_LENGTH(bench_type_map); i++) {
+    if (strcmp(type, bench_type_map[i].type_str) == 0) {
+      packet_type = bench_type_map[i].type_enum;
+      break;
+    }
+  }
+  for (uint8_t i = 0; i < ARRAY_LENGTH(bench_handlers); i++) {
+    if (packet_type == bench_handlers[i].type) return bench_handlers[i].handler_fn;
+  }
+  return NULL;
+}
+
+static wsat_event_handler_fn bench_table_lookup(const char* type)
+{
+  return wsat_event_default_handlers[wsat_packet_type_get(type)];
+}
+
+static double bench_run(wsat_event_handler_fn (* lookup_fn)(const char*))
+{
+  volatile uintptr_t sink = 0;
+  const uint64_t start = bench_time_ns();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += (uintptr_t)lookup_fn(bench_types[i % ARRAY_LENGTH(bench_types)]);
+  }
+  return (double)(bench_time_ns() - start) / BENCH_ITERATIONS;
+}
+
+int main()
+{
+  for (uint8_t i = 0; i < ARRAY_LENGTH(bench_handlers); i++) {
+    bench_handlers[i].handler_fn = wsat_event_default_handlers[bench_handlers[i].type];
+  }
+  for (uint8_t i = 0; i < ARRAY_LENGTH(bench_types); i++) {
+    if (bench_linear_lookup(bench_types[i]) != bench_table_lookup(bench_types[i])) {
+      printf("Lookups differ for \"%s\"!\n", bench_types[i]);
+      return 1;
+    }
+  }
+  printf("%d lookups over %d types\n", BENCH_ITERATIONS, (int)ARRAY_LENGTH(bench_types));
+  printf("%10s %16s\n", "approach", "ns/event");
+  printf("%10s %16.2f\n", "linear", bench_run(bench_linear_lookup));
+  printf("%10s %16.2f\n", "table", bench_run(bench_table_lookup));
+  return 0;
+}
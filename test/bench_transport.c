@@ -0,0 +1,183 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Compares transports, round-trip time of small messages (like ping and pong), and throughput of a stream
+ * of audio-sized blocks. Both ends of connection run in this process, server end in its own thread.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "satellite_priv.h"
+
+#define BENCH_UNIX_PATH "/tmp/wsat_bench_transport.sock"
+#define BENCH_MESSAGE_SIZE 64
+#define BENCH_MESSAGE_COUNT 20000
+#define BENCH_BLOCK_SIZE 4096
+#define BENCH_STREAM_SIZE (64 * 1024 * 1024)
+
+struct bench_conn
+{
+  const struct wsat_transport* transport;
+  int fd;
+};
+
+static uint64_t bench_time_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_write_all(struct bench_conn* conn, const uint8_t* data, uint32_t length)
+{
+  while (length > 0) {
+    struct iovec iov = { (void*)data, length };
+    const int32_t res = conn->transport->writev_fn(conn->fd, &iov, 1, false);
+    if (res < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        printf("Write failed: %d\n", errno);
+        exit(1);
+      }
+      conn->transport->wait_fn(conn->fd, true, -1, -1);
+      continue;
+    }
+    data += res;
+    length -= res;
+  }
+}
+
+// Returns false, when connection was closed
+static bool bench_read_all(struct bench_conn* conn, uint8_t* data, uint32_t length)
+{
+  while (length > 0) {
+    if (conn->transport->wait_fn(conn->fd, false, -1, -1) < 0) return false;
+    struct iovec iov = { data, length };
+    const int32_t res = conn->transport->read_fn(conn->fd, &iov, 1);
+    if (res == 0) return false;
+    if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      return false;
+    }
+    data += res;
+    length -= res;
+  }
+  return true;
+}
+
+static void* bench_echo_thread_fn(void* opaque)
+{
+  struct bench_conn* conn = opaque;
+  uint8_t message[BENCH_MESSAGE_SIZE];
+  for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++) {
+    if (!bench_read_all(conn, message, sizeof(message))) break;
+    bench_write_all(conn, message, sizeof(message));
+  }
+  return NULL;
+}
+
+static void* bench_sink_thread_fn(void* opaque)
+{
+  struct bench_conn* conn = opaque;
+  static uint8_t block[BENCH_BLOCK_SIZE];
+  for (uint32_t received = 0; received < BENCH_STREAM_SIZE; received += sizeof(block)) {
+    if (!bench_read_all(conn, block, sizeof(block))) break;
+  }
+  return NULL;
+}
+
+static int bench_connect(const struct wsat_transport* transport, int listener)
+{
+#if WSAT_WAKEUP != WSAT_WAKEUP_NONE
+  if (transport == &wsat_transport_loopback) return wsat_transport_loopback_connect();
+#endif
+  int fd;
+  if (transport == &wsat_transport_tcp) {
+    struct sockaddr_in addr;
+    socklen_t addr_length = sizeof(addr);
+    getsockname(listener, (struct sockaddr*)&addr, &addr_length); // Listening on port picked by system
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return -1;
+  } else {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, BENCH_UNIX_PATH);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) return -1;
+  }
+  return fd;
+}
+
+static void bench_run(const struct wsat_transport* transport, const char* address)
+{
+  struct wsat_config config;
+  wsat_config_default_get(&config);
+  config.address = address;
+  config.port = 0;
+  const int listener = transport->listen_fn(&config);
+  if (listener < 0) {
+    printf("%10s %16s\n", transport->name, "not available");
+    return;
+  }
+  struct bench_conn client = { transport, bench_connect(transport, listener) };
+  struct bench_conn server = { transport, -1 };
+  if (client.fd >= 0 && transport->wait_fn(listener, false, -1, 1000) == 1) server.fd = transport->accept_fn(listener, &config);
+  if (server.fd < 0) {
+    printf("%10s %16s\n", transport->name, "can't connect");
+    if (client.fd >= 0) transport->close_fn(client.fd);
+    transport->close_fn(listener);
+    return;
+  }
+  pthread_t thread;
+
+  uint8_t message[BENCH_MESSAGE_SIZE];
+  memset(message, 'P', sizeof(message));
+  pthread_create(&thread, NULL, bench_echo_thread_fn, &server);
+  uint64_t start = bench_time_ns();
+  for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++) {
+    bench_write_all(&client, message, sizeof(message));
+    bench_read_all(&client, message, sizeof(message));
+  }
+  const double rtt_us = (double)(bench_time_ns() - start) / BENCH_MESSAGE_COUNT / 1000.0;
+  pthread_join(thread, NULL);
+
+  static uint8_t block[BENCH_BLOCK_SIZE];
+  memset(block, 'A', sizeof(block));
+  pthread_create(&thread, NULL, bench_sink_thread_fn, &server);
+  start = bench_time_ns();
+  for (uint32_t sent = 0; sent < BENCH_STREAM_SIZE; sent += sizeof(block)) {
+    bench_write_all(&client, block, sizeof(block));
+  }
+  pthread_join(thread, NULL);
+  const double mb_per_s = (double)BENCH_STREAM_SIZE / (1024.0 * 1024.0) /
+                          ((double)(bench_time_ns() - start) / 1000000000.0);
+
+  transport->close_fn(client.fd);
+  transport->close_fn(server.fd);
+  transport->close_fn(listener);
+  printf("%10s %16.2f %16.1f\n", transport->name, rtt_us, mb_per_s);
+}
+
+int main()
+{
+  printf("%d round trips of %d bytes, %d MB in blocks of %d bytes\n", BENCH_MESSAGE_COUNT, BENCH_MESSAGE_SIZE,
+         BENCH_STREAM_SIZE / (1024 * 1024), BENCH_BLOCK_SIZE);
+  printf("%10s %16s %16s\n", "transport", "round trip us", "MB/s");
+  bench_run(&wsat_transport_tcp, "127.0.0.1");
+#if WSAT_TRANSPORT_UNIX
+  bench_run(&wsat_transport_unix, BENCH_UNIX_PATH);
+  unlink(BENCH_UNIX_PATH);
+#endif
+#if WSAT_WAKEUP != WSAT_WAKEUP_NONE
+  bench_run(&wsat_transport_loopback, NULL);
+#endif
+  return 0;
+}
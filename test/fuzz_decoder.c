@@ -0,0 +1,94 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Fuzzing harness of wsat_event_decoder_next.
+ * Built as libFuzzer target by default. With WSAT_FUZZ_STANDALONE it gets its own main, which reads input
+ * from file given as argument or from stdin, so it can be used with AFL (afl-clang-fast) or for replaying crashes.
+ * First bytes of input select chunk size, skip mask and spill buffer, rest is fed to the decoder as stream.
+ */
+
+#undef NDEBUG // Harness relies on assert
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "satellite_priv.h"
+
+#define FUZZ_CONFIG_LENGTH 3
+
+static void fuzz_event_check(struct wsat_event_decoder* dec, struct wsat_decoded_event* evt)
+{
+  assert(evt->payload.size <= evt->header.payload_length);
+  assert(evt->payload.offset + evt->payload.size <= evt->header.payload_length);
+  assert(memchr(evt->header.type, '\0', sizeof(evt->header.type)) != NULL);
+  if (evt->payload.size > 0) {
+    // Touch whole payload, so sanitizers catch chunk pointing outside of the buffers
+    volatile uint8_t sum = 0;
+    for (uint32_t i = 0; i < evt->payload.size; i++) sum += evt->payload.data[i];
+    assert((uintptr_t)evt->payload.data % EVENT_DECODER_PAYLOAD_ALIGNMENT == 0);
+  }
+  if (evt->flags & WSAT_DECODED_EVENT_FLAG_BEGIN) wsat_decoded_event_get_data(evt);
+  assert(dec->buffer_length <= EVENT_DECODER_RING_CAPACITY);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  static struct wsat_event_decoder dec;
+  static uint8_t spill[4 * EVENT_DECODER_BUFFER_SIZE];
+  struct wsat_decoded_event* evt;
+  if (size < FUZZ_CONFIG_LENGTH) return 0;
+  const uint32_t chunk_size = data[0] == 0 ? EVENT_DECODER_BUFFER_SIZE : data[0];
+  const uint32_t skip_mask = data[1] & 1 ? ~(uint32_t)0x3ff : 0;
+  wsat_event_decoder_reset(&dec);
+  wsat_event_decoder_skip_set(&dec, skip_mask);
+  wsat_event_decoder_spill_set(&dec, data[2] & 1 ? spill : NULL, data[2] & 1 ? sizeof(spill) : 0);
+  data += FUZZ_CONFIG_LENGTH;
+  size -= FUZZ_CONFIG_LENGTH;
+  size_t offset = 0;
+  while (offset < size) {
+    struct wsat_buffer_region regions[2];
+    const uint32_t region_count = wsat_event_decoder_buffer_get(&dec, regions);
+    const size_t left = size - offset;
+    uint32_t chunk_left = left < chunk_size ? left : chunk_size;
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < region_count && written < chunk_left; i++) {
+      const uint32_t length = regions[i].length < chunk_left - written ? regions[i].length : chunk_left - written;
+      memcpy(regions[i].data, data + offset + written, length);
+      written += length;
+    }
+    // Decoder must always make space for more data
+    assert(written > 0);
+    wsat_event_decoder_buffer_advance(&dec, written);
+    offset += written;
+    while (wsat_event_decoder_next(&dec, &evt) == 1) {
+      fuzz_event_check(&dec, evt);
+      if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) wsat_decoded_event_free(evt);
+    }
+  }
+  // Event left unfinished by end of the input is freed as on disconnect
+  wsat_event_decoder_reset(&dec);
+  wsat_event_decoder_spill_set(&dec, NULL, 0);
+  return 0;
+}
+
+#ifdef WSAT_FUZZ_STANDALONE
+int main(int argc, char** argv)
+{
+  FILE* f = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  if (f == NULL) return 1;
+  size_t capacity = 64 * 1024, size = 0;
+  uint8_t* data = malloc(capacity);
+  while (true) {
+    size += fread(data + size, 1, capacity - size, f);
+    if (size < capacity) break;
+    capacity *= 2;
+    data = realloc(data, capacity);
+  }
+  if (f != stdin) fclose(f);
+  LLVMFuzzerTestOneInput(data, size);
+  free(data);
+  return 0;
+}
+#endif
@@ -0,0 +1,60 @@
+// Configuration of tests built with library defaults, only platform glue is provided
+
+#ifndef WYOMING_USER_H_
+#define WYOMING_USER_H_
+
+// System libraries
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Include required libraries
+#include <cJSON.h>
+#include <sys/socket.h> // POSIX Sockets
+#include <sys/uio.h> // POSIX Sockets, scatter/gather reads
+#include <netinet/in.h> // POSIX Sockets
+#include <arpa/inet.h> // POSIX Sockets, parsing of listen address
+#include <unistd.h> // For Sockets
+#include <poll.h> // POSIX Sockets, waiting for sockets and wakeup channel
+#include <sys/ioctl.h> // Optional, bytes waiting in socket (TIOCOUTQ)
+#include <netinet/tcp.h> // Optional, TCP_NODELAY, keepalive and round-trip time of connection (TCP_INFO)
+
+// Logging implementation
+
+void debug_print(char type, const char* format, ...);
+
+#define LOGD(...) debug_print('D', __VA_ARGS__)
+#define LOGE(...) debug_print('E', __VA_ARGS__)
+#define LOGI(...) debug_print('I', __VA_ARGS__)
+
+// Platform related macros
+
+#define PLAT_THREAD_TYPE pthread_t
+#define PLAT_THREAD_CREATE(thread, start_routine, name, stack_size, priority) pthread_create(thread, NULL, start_routine, NULL)
+#define PLAT_THREAD_JOIN(thread) pthread_join(*thread, NULL)
+
+#define PLAT_MUTEX_TYPE pthread_mutex_t
+#define PLAT_MUTEX_CREATE(mutex) pthread_mutex_init(mutex, NULL)
+// WARNING: Mutex destroy can be called on non-created mutex.
+#define PLAT_MUTEX_DESTROY(mutex) pthread_mutex_destroy(mutex)
+#define PLAT_MUTEX_LOCK(mutex) pthread_mutex_lock(mutex)
+#define PLAT_MUTEX_UNLOCK(mutex) pthread_mutex_unlock(mutex)
+
+#define PLAT_SEM_TYPE sem_t
+#define PLAT_SEM_CREATE(sem, initial) sem_init(sem, 0, initial)
+#define PLAT_SEM_DESTROY(sem) sem_destroy(sem)
+#define PLAT_SEM_TAKE(sem) while (sem_wait(sem) != 0) // Retried, as it can be interrupted by signal
+#define PLAT_SEM_GIVE(sem) sem_post(sem)
+int plat_sem_take_timeout(sem_t* sem, uint32_t timeout_ms);
+#define PLAT_SEM_TAKE_TIMEOUT(sem, timeout_ms) plat_sem_take_timeout(sem, timeout_ms)
+
+#define PLAT_THREAD_LOCAL _Thread_local
+
+#define PLAT_MALLOC(size) malloc(size)
+#define PLAT_FREE(ptr) free(ptr)
+
+#define EVENT_DECODER_BUFFER_SIZE (4096)
+// Everything else is left at library defaults: no clock, spill buffer, arena, send queue or audio chunking
+
+#endif
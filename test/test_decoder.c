@@ -0,0 +1,740 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Unit tests of the event decoder, feeding hand-crafted streams and checking decoded events and decoder state.
+ */
+
+#undef NDEBUG // Tests rely on assert
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "satellite_priv.h"
+
+static uint32_t test_decoder_write(struct wsat_event_decoder* dec, const void* src, uint32_t size)
+{
+  struct wsat_buffer_region regions[2];
+  const uint32_t region_count = wsat_event_decoder_buffer_get(dec, regions);
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < region_count && written < size; i++) {
+    const uint32_t left = size - written;
+    const uint32_t length = regions[i].length < left ? regions[i].length : left;
+    memcpy(regions[i].data, (const uint8_t*)src + written, length);
+    written += length;
+  }
+  if (written < size) LOGD("TEST: cap %d < size %d", written, size);
+  wsat_event_decoder_buffer_advance(dec, written);
+  return written;
+}
+
+static void test_wsat_decoder()
+{
+  int32_t res = 0;
+  struct wsat_decoded_event* evt;
+  static struct wsat_event_decoder dec;
+#define MEMCPY_BUFFER(SRC, SIZE) test_decoder_write(&dec, SRC, SIZE)
+  if (1){
+    // Test initial partial header with junk on start
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "zxzzc{\"type\":\"test_wsat_decoder\"";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 27);
+    assert(dec.buffer[dec.read_pos] == '{');
+    // Now add rest + some junk on the end
+    const char* p2 = ",\"something\": true}\nabcdefghi";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "test_wsat_decoder") == 0);
+    assert(dec.buffer_length == 9);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Test too big header at once
+    wsat_event_decoder_reset(&dec);
+    const char p1[EVENT_DECODER_BUFFER_SIZE] = "{\"type\":\"test_wsat_decoder\"";
+    MEMCPY_BUFFER(p1, sizeof(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 0);
+    // Too big header in two steps
+    wsat_event_decoder_reset(&dec);
+    MEMCPY_BUFFER(p1, 45);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 45);
+    MEMCPY_BUFFER(p1, EVENT_DECODER_BUFFER_SIZE);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+#if EVENT_DECODER_SPILL_MAX_SIZE > 0
+    // Header is collected in spill buffer, nothing is left in the ring
+    assert(dec.buffer_length == 0);
+#else
+    // Only the leading brace is dropped, so the decoder resyncs on start of the second copy
+    assert(dec.buffer_length == EVENT_DECODER_RING_CAPACITY - 45);
+    assert(dec.buffer[dec.read_pos] == '{');
+#endif
+  }
+  if (1){
+    // Test two JSONs between
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "zzzz{\"type\":\"fake\"}{\"type\":\"real\"}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(dec.buffer_length == 0);
+    assert(strcmp(evt->header.type, "real") == 0);
+    wsat_decoded_event_free(evt);
+    // Test look-a-like JSON and real JSON
+    wsat_event_decoder_reset(&dec);
+    const char* p2 = "zzzzz{\"wannabejson\"}{\"type\":\"real\"}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(dec.buffer_length == 0);
+    assert(strcmp(evt->header.type, "real") == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Data test
+    wsat_event_decoder_reset(&dec);
+    dec.state = WSAT_EVENT_DECODER_PROCESS_STATE_DATA;
+    dec.wip_evt.header.data_length = 10;
+    const char* p1 = "{\"z\":";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 5);
+    const char* p2 = "1337}";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(dec.buffer_length == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Full packet test with segmentation variation 1
+    uint8_t payload[5056];
+    for (int i = 0; i < sizeof(payload); i++) payload[i] = i % 256 + i / 256;
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":\"test\",";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    // assert(dec.buffer_length == strlen(p1));
+    const char* p2 = "\"data_length\":18,\"payload_length\":5056}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA);
+    // assert(dec.buffer_length == strlen(p1));
+    const char* p3 = "{\"somethi";
+    MEMCPY_BUFFER(p3, strlen(p3));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA);
+    const char* p4 = "ng\":true}";
+    MEMCPY_BUFFER(p4, strlen(p4));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    // Data is complete, but it's kept in buffer until first byte of payload arrives
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_DATA);
+    uint8_t payload_output[5056];
+    // Data block still takes its part of the ring, so only the rest is filled with payload
+    const uint32_t first_chunk_size = EVENT_DECODER_RING_CAPACITY - 18;
+    MEMCPY_BUFFER(payload, first_chunk_size);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_PAYLOAD);
+    assert(dec.buffer_length == 0);
+    assert(dec.payload_received == first_chunk_size);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
+    assert(evt->payload.offset == 0);
+    assert(evt->payload.size == first_chunk_size);
+    assert(evt->payload.data[2] == payload[2]);
+    // Payload was moved past the data block to start aligned, data block itself stays intact
+    assert((uintptr_t)evt->payload.data % EVENT_DECODER_PAYLOAD_ALIGNMENT == 0);
+    assert(evt->data == NULL && evt->data_span.length == 18);
+    cJSON* something = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "something");
+    assert(something != NULL && cJSON_IsTrue(something));
+    memcpy(payload_output + evt->payload.offset, evt->payload.data, evt->payload.size);
+    MEMCPY_BUFFER(payload + first_chunk_size, sizeof(payload) - first_chunk_size);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_END | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
+    assert(evt->payload.offset == first_chunk_size);
+    assert(evt->payload.size == sizeof(payload) - first_chunk_size);
+    // Parsed data is kept for the rest of the event
+    assert(evt->data_span.json == NULL);
+    assert(cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "something") == something);
+    assert(dec.payload_received == 0);
+    assert(dec.buffer_length == 0);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER);
+    memcpy(payload_output + evt->payload.offset, evt->payload.data, evt->payload.size);
+    wsat_decoded_event_free(evt);
+    for (int i = 0; i < sizeof(payload); i++) assert(payload[i] == payload_output[i]);
+  }
+  if (1){
+    // Simple header-only event in single chunk
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":\"simple\"}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "simple") == 0);
+    assert(dec.buffer_length == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Two headers back-to-back in one buffer
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":\"first\"}\n{\"type\":\"second\"}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "first") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length > 0);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "second") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Junk + partial header, then completion
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "junk{\"type\":\"par";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == strlen("{\"type\":\"par"));
+    assert(memcmp(dec.buffer + dec.read_pos, "{\"type\":\"par", dec.buffer_length) == 0);
+    const char* p2 = "tial\"}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "partial") == 0);
+    assert(dec.buffer_length == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Header + data in one buffer
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":\"data-only\",\"data_length\":10}\n{\"x\":1234}";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "data-only") == 0);
+    cJSON* x = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "x");
+    assert(x != NULL && cJSON_IsNumber(x));
+    assert((int)cJSON_GetNumberValue(x) == 1234);
+    assert(dec.buffer_length == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1){
+    // Data split across chunks with next header preserved
+    wsat_event_decoder_reset(&dec);
+    const char* h1 = "{\"type\":\"data-chunk\",\"data_length\":12}\n";
+    const char* d1 = "{\"foo\":";
+    const char* d2 = "true}";
+    const char* h2 = "{\"type\":\"next\"}\n";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    MEMCPY_BUFFER(d1, strlen(d1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    MEMCPY_BUFFER(d2, strlen(d2));
+    MEMCPY_BUFFER(h2, strlen(h2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "data-chunk") == 0);
+    cJSON* foo = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "foo");
+    assert(foo != NULL && cJSON_IsBool(foo) && cJSON_IsTrue(foo));
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == strlen(h2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "next") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Header + payload in one buffer
+    uint8_t payload[4] = {1, 2, 3, 4};
+    wsat_event_decoder_reset(&dec);
+    const char* h1 = "{\"type\":\"payload-one\",\"payload_length\":4}\n";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    MEMCPY_BUFFER(payload, sizeof(payload));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
+                         WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "payload-one") == 0);
+    assert(evt->payload.offset == 0);
+    assert(evt->payload.size == sizeof(payload));
+    assert(memcmp(evt->payload.data, payload, sizeof(payload)) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Payload split into multiple chunks
+    uint8_t payload[9] = {10, 11, 12, 13, 14, 15, 16, 17, 18};
+    wsat_event_decoder_reset(&dec);
+    const char* h1 = "{\"type\":\"payload-chunks\",\"payload_length\":9}\n";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    MEMCPY_BUFFER(payload, 2);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
+    assert(evt->payload.offset == 0);
+    assert(evt->payload.size == 2);
+    assert(memcmp(evt->payload.data, payload, 2) == 0);
+    MEMCPY_BUFFER(payload + 2, 3);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == WSAT_DECODED_EVENT_FLAG_PAYLOAD);
+    assert(evt->payload.offset == 2);
+    assert(evt->payload.size == 3);
+    assert(memcmp(evt->payload.data, payload + 2, 3) == 0);
+    MEMCPY_BUFFER(payload + 5, 4);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_PAYLOAD | WSAT_DECODED_EVENT_FLAG_END));
+    assert(evt->payload.offset == 5);
+    assert(evt->payload.size == 4);
+    assert(memcmp(evt->payload.data, payload + 5, 4) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER);
+  }
+  if (1){
+    // Skip invalid header and parse the next one
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":123}\n{\"type\":\"good\"}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "good") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Data length too big should discard header
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"type\":\"big-data\",\"data_length\":4294967295,\"payload_length\":1}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Garbage in the middle of the stream doesn't throw away events behind it
+    wsat_event_decoder_reset(&dec);
+    const struct wsat_decoder_stats stats_before = dec.stats;
+    const char* p1 = "{\"type\":\"a\"}\n\x01\x02garbage}\n{\"type\":\"b\"}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1 && strcmp(evt->header.type, "a") == 0);
+    wsat_decoded_event_free(evt);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1 && strcmp(evt->header.type, "b") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.stats.resync_skipped_bytes == stats_before.resync_skipped_bytes + 11);
+    // Data which is not JSON object means lengths in the header are wrong, so next header is searched from there
+    const char* p2 = "{\"type\":\"c\",\"data_length\":20,\"payload_length\":100}\nxx{\"type\":\"d\"}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1 && strcmp(evt->header.type, "d") == 0);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_HEADER);
+    wsat_decoded_event_free(evt);
+    // Same when the data block doesn't end where header says
+    const char* p3 = "{\"type\":\"e\",\"data_length\":5}\n{\"a\":{\"type\":\"f\"}\n";
+    MEMCPY_BUFFER(p3, strlen(p3));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1 && strcmp(evt->header.type, "f") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+    assert(dec.stats.resync_count == stats_before.resync_count + 2);
+    // Truncated header followed by whole one, which starts before where tokenizer gives up on the truncated one
+    const char* truncated[] = {
+      "{\"type\":\"audio-chu{\"type\":\"ping\"}\n",
+      "{\"type\":\"audio-chunk\",\"data_le{\"type\":\"ping\"}\n",
+    };
+    for (uint32_t i = 0; i < ARRAY_LENGTH(truncated); i++) {
+      MEMCPY_BUFFER(truncated[i], strlen(truncated[i]));
+      res = wsat_event_decoder_next(&dec, &evt);
+      assert(res == 1 && strcmp(evt->header.type, "ping") == 0);
+      wsat_decoded_event_free(evt);
+      assert(dec.buffer_length == 0);
+    }
+    // Never-ending header, which fills the ring and doesn't fit into spill buffer, is searched for next header start
+    static uint8_t spill[16];
+    wsat_event_decoder_spill_set(&dec, spill, sizeof(spill));
+    static char p4[EVENT_DECODER_BUFFER_SIZE + 64];
+    memset(p4, 'x', sizeof(p4));
+    memcpy(p4, "{\"type\":\"never-ending", 21);
+    const char* p5 = "{\"type\":\"g\"}\n";
+    memcpy(p4 + EVENT_DECODER_BUFFER_SIZE - 8, p5, strlen(p5));
+    uint32_t offset = 0;
+    bool is_found = false;
+    while (offset < EVENT_DECODER_BUFFER_SIZE - 8 + strlen(p5)) {
+      offset += MEMCPY_BUFFER(p4 + offset, EVENT_DECODER_BUFFER_SIZE - 8 + strlen(p5) - offset);
+      while (wsat_event_decoder_next(&dec, &evt) == 1) {
+        assert(strcmp(evt->header.type, "g") == 0);
+        is_found = true;
+        wsat_decoded_event_free(evt);
+      }
+    }
+    assert(is_found);
+    wsat_event_decoder_spill_set(&dec, NULL, 0);
+  }
+  if (1){
+    // Header and data bigger than the ring are collected in spill buffer
+    static uint8_t spill[3 * EVENT_DECODER_BUFFER_SIZE];
+    static uint8_t stream[4 * EVENT_DECODER_BUFFER_SIZE];
+    static char pad[6000 + 1];
+    memset(pad, 'x', sizeof(pad) - 1);
+    wsat_event_decoder_reset(&dec);
+    wsat_event_decoder_spill_set(&dec, spill, sizeof(spill));
+    const struct wsat_decoder_stats stats_before = dec.stats;
+    const uint32_t data_length = sizeof(pad) - 1 + 10;
+    uint32_t stream_length = snprintf((char*)stream, sizeof(stream),
+                                      "{\"type\":\"info\",\"pad\":\"%s\",\"data_length\":%u,\"payload_length\":3}\n"
+                                      "{\"pad\":\"%s\"}abc{\"type\":\"next\"}\n", pad, data_length, pad);
+    uint32_t offset = 0, payload_received = 0;
+    bool is_info_done = false, is_next_done = false;
+    while (offset < stream_length) {
+      const uint32_t left = stream_length - offset;
+      offset += MEMCPY_BUFFER(stream + offset, left < 1000 ? left : 1000);
+      while (wsat_event_decoder_next(&dec, &evt) == 1) {
+        if (strcmp(evt->header.type, "info") == 0) {
+          if (evt->flags & WSAT_DECODED_EVENT_FLAG_BEGIN) {
+            cJSON* pad_item = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "pad");
+            assert(pad_item != NULL && strlen(cJSON_GetStringValue(pad_item)) == sizeof(pad) - 1);
+          }
+          assert(memcmp(evt->payload.data, "abc" + payload_received, evt->payload.size) == 0);
+          payload_received += evt->payload.size;
+          is_info_done = evt->flags & WSAT_DECODED_EVENT_FLAG_END;
+        } else {
+          assert(is_info_done && strcmp(evt->header.type, "next") == 0);
+          is_next_done = true;
+        }
+        if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) wsat_decoded_event_free(evt);
+      }
+    }
+    assert(is_info_done && is_next_done && payload_received == 3);
+    assert(dec.stats.spill_header_count == stats_before.spill_header_count + 1);
+    assert(dec.stats.spill_data_count == stats_before.spill_data_count + 1);
+    assert(dec.stats.spill_fail_count == stats_before.spill_fail_count);
+    // Truncated header bigger than the ring, whole header behind it is found in spill buffer
+    static char truncated[sizeof(pad) + 64];
+    const uint32_t truncated_length = snprintf(truncated, sizeof(truncated),
+                                               "{\"type\":\"info\",\"pad\":\"%s{\"type\":\"ping\"}\n", pad);
+    wsat_event_decoder_reset(&dec);
+    offset = 0;
+    is_next_done = false;
+    while (offset < truncated_length) {
+      const uint32_t left = truncated_length - offset;
+      offset += MEMCPY_BUFFER(truncated + offset, left < 1000 ? left : 1000);
+      while (wsat_event_decoder_next(&dec, &evt) == 1) {
+        assert(!is_next_done && strcmp(evt->header.type, "ping") == 0);
+        is_next_done = true;
+        wsat_decoded_event_free(evt);
+      }
+    }
+    assert(is_next_done);
+    assert(dec.buffer_length == 0 && dec.spill.length == 0);
+    // Too small spill buffer drops the event, but decoder recovers on next header
+    wsat_event_decoder_reset(&dec);
+    wsat_event_decoder_spill_set(&dec, spill, EVENT_DECODER_BUFFER_SIZE + 100);
+    offset = 0;
+    is_next_done = false;
+    while (offset < stream_length) {
+      const uint32_t left = stream_length - offset;
+      offset += MEMCPY_BUFFER(stream + offset, left < 1000 ? left : 1000);
+      while (wsat_event_decoder_next(&dec, &evt) == 1) {
+        assert(strcmp(evt->header.type, "info") != 0);
+        is_next_done |= strcmp(evt->header.type, "next") == 0;
+        if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) wsat_decoded_event_free(evt);
+      }
+    }
+    assert(is_next_done);
+    assert(dec.stats.spill_fail_count > stats_before.spill_fail_count);
+    wsat_event_decoder_spill_set(&dec, NULL, 0);
+  }
+  if (1){
+    // Events nobody handles are skipped, with their data and payload split across reads
+    wsat_event_decoder_reset(&dec);
+    wsat_event_decoder_skip_set(&dec, WSAT_PACKET_TYPE_BIT(WSAT_EVENT_TYPE_NONE) |
+                                      WSAT_PACKET_TYPE_BIT(WSAT_EVENT_TYPE_AUDIO_CHUNK));
+    const uint32_t skip_count = dec.stats.skip_count;
+    const char* h1 = "{\"type\":\"audio-chunk\",\"data_length\":9,\"payload_length\":6}\n{\"a\":\"b\"}{\"ty";
+    const char* h2 = "pe\"{\"type\":\"unknown\"}\n{\"type\":\"ping\"}\n";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.state == WSAT_EVENT_DECODER_PROCESS_STATE_SKIP);
+    assert(dec.buffer_length == 0);
+    MEMCPY_BUFFER(h2, strlen(h2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "ping") == 0);
+    assert(evt->packet_type == WSAT_EVENT_TYPE_PING);
+    assert(dec.buffer_length == 0);
+    assert(dec.stats.skip_count == skip_count + 2);
+    wsat_decoded_event_free(evt);
+    wsat_event_decoder_skip_set(&dec, 0);
+  }
+  if (1){
+    // Header + data + payload in one buffer
+    uint8_t payload[4] = {21, 22, 23, 24};
+    wsat_event_decoder_reset(&dec);
+    const char* h1 = "{\"type\":\"data-payload\",\"data_length\":7,\"payload_length\":4}\n";
+    const char* data = "{\"a\":1}";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    MEMCPY_BUFFER(data, strlen(data));
+    MEMCPY_BUFFER(payload, sizeof(payload));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
+                         WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "data-payload") == 0);
+    cJSON* a = cJSON_GetObjectItem(wsat_decoded_event_get_data(evt), "a");
+    assert(a != NULL && cJSON_IsNumber(a));
+    assert((int)cJSON_GetNumberValue(a) == 1);
+    assert(evt->payload.offset == 0);
+    assert(evt->payload.size == sizeof(payload));
+    assert(memcmp(evt->payload.data, payload, sizeof(payload)) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Payload chunk data should remain valid when next header follows
+    uint8_t payload[3] = {'a', 'b', 'c'};
+    wsat_event_decoder_reset(&dec);
+    const char* h1 = "{\"type\":\"payload-next\",\"payload_length\":3}\n";
+    const char* h2 = "{\"type\":\"after\",\"very_long\":\"aaaaaaaaaaaaaaaaaaaaaaaa\"}\n";
+    MEMCPY_BUFFER(h1, strlen(h1));
+    MEMCPY_BUFFER(payload, sizeof(payload));
+    MEMCPY_BUFFER(h2, strlen(h2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
+                         WSAT_DECODED_EVENT_FLAG_END));
+    assert(strcmp(evt->header.type, "payload-next") == 0);
+    assert(memcmp(evt->payload.data, payload, sizeof(payload)) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == strlen(h2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "after") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+  if (1){
+    // Header start split across chunks should be handled
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    const char* p2 = "\"type\":\"split\"}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "split") == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1) {
+    // Header starts one byte before with junk on start
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "junk{";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    assert(dec.buffer_length == 1);
+    const char* p2 = "\"type\":\"test\"}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "test") == 0);
+    wsat_decoded_event_free(evt);
+  }
+  if (1) {
+    // Header tokenizer skips nested values and strings with delimiters inside
+    wsat_event_decoder_reset(&dec);
+    const char* p1 = "{\"data\":{\"a\":[1,{\"b\":\"}\\\"{\"}],\"c\":null},\"type\":\"nested\",\"x\":-1.5e3}\n";
+    MEMCPY_BUFFER(p1, strlen(p1));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "nested") == 0);
+    assert(evt->header.data_length == 0 && evt->header.payload_length == 0);
+    wsat_decoded_event_free(evt);
+    // Lengths must be non-negative integers
+    const char* p2 = "{\"type\":\"neg\",\"payload_length\":-1}\n{\"type\":\"frac\",\"data_length\":1.5}\n"
+                     "{\"type\":\"ok\",\"payload_length\": 0}\n";
+    MEMCPY_BUFFER(p2, strlen(p2));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "ok") == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+    // Too long type is truncated
+    const char* p3 = "{\"type\":\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\"}\n";
+    MEMCPY_BUFFER(p3, strlen(p3));
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strlen(evt->header.type) == WSAT_EVENT_TYPE_MAX_LENGTH - 1);
+    wsat_decoded_event_free(evt);
+  }
+  if (1) {
+    // Every known type has its own slot in the type table, unknown ones are not matched
+    static const char* types[] = {
+      [WSAT_EVENT_TYPE_DESCRIBE] = "describe", [WSAT_EVENT_TYPE_PING] = "ping",
+      [WSAT_EVENT_TYPE_RUN_SATELLITE] = "run-satellite", [WSAT_EVENT_TYPE_PAUSE_SATELLITE] = "pause-satellite",
+      [WSAT_EVENT_TYPE_AUDIO_START] = "audio-start", [WSAT_EVENT_TYPE_AUDIO_CHUNK] = "audio-chunk",
+      [WSAT_EVENT_TYPE_AUDIO_STOP] = "audio-stop", [WSAT_EVENT_TYPE_DETECTION] = "detection",
+      [WSAT_EVENT_TYPE_VOICE_STOPPED] = "voice-stopped", [WSAT_EVENT_TYPE_ERROR] = "error",
+      [WSAT_EVENT_TYPE_TRANSCRIPT] = "transcript",
+    };
+    _Static_assert(ARRAY_LENGTH(types) == WSAT_EVENT_TYPE_COUNT, "Every packet type must be tested");
+    for (uint8_t i = WSAT_EVENT_TYPE_NONE + 1; i < WSAT_EVENT_TYPE_COUNT; i++) {
+      assert(wsat_packet_type_get(types[i]) == i);
+    }
+    assert(wsat_packet_type_get("") == WSAT_EVENT_TYPE_NONE);
+    assert(wsat_packet_type_get("audio-stot") == WSAT_EVENT_TYPE_NONE);
+    assert(wsat_packet_type_get("pong") == WSAT_EVENT_TYPE_NONE);
+  }
+  if (1) {
+    // Pair search, across vector boundaries and at the very end
+    static uint8_t data[100];
+    memset(data, '{', sizeof(data));
+    assert(wsat_find_byte_pair(data, sizeof(data), '{', '"') == NULL);
+    data[sizeof(data) - 1] = '"';
+    assert(wsat_find_byte_pair(data, sizeof(data), '{', '"') == data + sizeof(data) - 2);
+    assert(wsat_find_byte_pair(data, sizeof(data) - 1, '{', '"') == NULL);
+    data[16] = '"';
+    assert(wsat_find_byte_pair(data, sizeof(data), '{', '"') == data + 15);
+    assert(wsat_find_byte_pair(data, 1, '{', '"') == NULL);
+    assert(wsat_find_byte_pair(data, 0, '{', '"') == NULL);
+  }
+  if (1) {
+    // Audio chunks arriving together with their headers, payloads start aligned and data blocks stay intact
+    const char* chunk = "{\"type\":\"audio-chunk\",\"data_length\":9,\"payload_length\":6}\n{\"a\":\"b\"}abcdef";
+    wsat_event_decoder_reset(&dec);
+    for (int i = 0; i < 3; i++) MEMCPY_BUFFER(chunk, strlen(chunk));
+    for (int i = 0; i < 3; i++) {
+      res = wsat_event_decoder_next(&dec, &evt);
+      assert(res == 1);
+      assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
+                           WSAT_DECODED_EVENT_FLAG_END));
+      assert((uintptr_t)evt->payload.data % EVENT_DECODER_PAYLOAD_ALIGNMENT == 0);
+      assert(evt->payload.size == 6 && memcmp(evt->payload.data, "abcdef", 6) == 0);
+      assert(evt->data_span.length == 9 && memcmp(evt->data_span.json, "{\"a\":\"b\"}", 9) == 0);
+      wsat_decoded_event_free(evt);
+    }
+    assert(dec.buffer_length == 0);
+    assert(dec.stats.payload_align_count > 0);
+  }
+  if (1) {
+    // Header and payload wrapping around the end of the ring
+    static uint8_t stream[EVENT_DECODER_BUFFER_SIZE + 256];
+    const char* h1 = "{\"type\":\"fill\",\"payload_length\":4000}\n";
+    const char* h2 = "{\"type\":\"wrapped\",\"payload_length\":200}\n";
+    const uint32_t h1_length = strlen(h1), h2_length = strlen(h2);
+    const uint32_t fill_length = EVENT_DECODER_RING_CAPACITY - 10 - h1_length;
+    char fill_header[64];
+    snprintf(fill_header, sizeof(fill_header), "{\"type\":\"fill\",\"payload_length\":%u}\n", fill_length);
+    assert(strlen(fill_header) == h1_length);
+    for (int i = 0; i < sizeof(stream); i++) stream[i] = (uint8_t)(i * 7);
+    memcpy(stream, fill_header, h1_length);
+    memcpy(stream + h1_length + fill_length, h2, h2_length);
+    wsat_event_decoder_reset(&dec);
+    assert(MEMCPY_BUFFER(stream, sizeof(stream)) == EVENT_DECODER_RING_CAPACITY);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "fill") == 0);
+    assert(evt->flags & WSAT_DECODED_EVENT_FLAG_END);
+    assert(evt->payload.size == fill_length);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 10);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 0);
+    // Rest of the second header and its payload continue from start of the ring
+    const uint32_t rest_offset = EVENT_DECODER_RING_CAPACITY;
+    const uint32_t rest_length = h1_length + fill_length + h2_length + 200 - rest_offset;
+    MEMCPY_BUFFER(stream + rest_offset, rest_length);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "wrapped") == 0);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD |
+                         WSAT_DECODED_EVENT_FLAG_END));
+    assert(evt->payload.size == 200);
+    assert(memcmp(evt->payload.data, stream + h1_length + fill_length + h2_length, 200) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+    // Payload wrapping around the end of the ring is handed out in two chunks
+    char pad_header[129];
+    memset(pad_header, 'x', sizeof(pad_header));
+    memcpy(pad_header, "{\"type\":\"pad\",\"pad\":\"", 21);
+    memcpy(pad_header + 125, "\"}\n", 3);
+    const uint32_t pad_length = 128;
+    const char* wrap_format = "{\"type\":\"wrapped\",\"payload_length\":%u}\n";
+    char wrap_header[64];
+    const uint32_t wrap_header_length = snprintf(wrap_header, sizeof(wrap_header), wrap_format, 1000);
+    // Payload is moved forward to start aligned, first chunk ends with the ring
+    const uint32_t payload_start = (pad_length + wrap_header_length + EVENT_DECODER_PAYLOAD_ALIGNMENT - 1) /
+                                   EVENT_DECODER_PAYLOAD_ALIGNMENT * EVENT_DECODER_PAYLOAD_ALIGNMENT;
+    const uint32_t first_chunk_length = EVENT_DECODER_BUFFER_SIZE - payload_start;
+    assert(snprintf(wrap_header, sizeof(wrap_header), wrap_format, first_chunk_length + 100) == wrap_header_length);
+    memcpy(stream, pad_header, pad_length);
+    memcpy(stream + pad_length, wrap_header, wrap_header_length);
+    wsat_event_decoder_reset(&dec);
+    MEMCPY_BUFFER(stream, EVENT_DECODER_BUFFER_SIZE - 100);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(strcmp(evt->header.type, "pad") == 0);
+    wsat_decoded_event_free(evt);
+    const uint32_t wrap_rest_length = pad_length + wrap_header_length + first_chunk_length + 100 -
+                                      (EVENT_DECODER_BUFFER_SIZE - 100);
+    assert(MEMCPY_BUFFER(stream + EVENT_DECODER_BUFFER_SIZE - 100, wrap_rest_length) == wrap_rest_length);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_BEGIN | WSAT_DECODED_EVENT_FLAG_PAYLOAD));
+    assert(evt->payload.size == first_chunk_length);
+    assert(evt->payload.data == dec.buffer + payload_start);
+    assert(memcmp(evt->payload.data, stream + pad_length + wrap_header_length, first_chunk_length) == 0);
+    res = wsat_event_decoder_next(&dec, &evt);
+    assert(res == 1);
+    assert(evt->flags == (WSAT_DECODED_EVENT_FLAG_PAYLOAD | WSAT_DECODED_EVENT_FLAG_END));
+    assert(evt->payload.data == dec.buffer);
+    assert(evt->payload.offset == first_chunk_length);
+    assert(evt->payload.size == 100);
+    assert(memcmp(evt->payload.data, stream + pad_length + wrap_header_length + first_chunk_length, 100) == 0);
+    wsat_decoded_event_free(evt);
+    assert(dec.buffer_length == 0);
+  }
+}
+
+int main()
+{
+  test_wsat_decoder();
+  printf("test_wsat_decoder passed\n");
+  return 0;
+}
@@ -0,0 +1,121 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Unit tests of the JSON writer used for outbound events, output is checked also by parsing it with cJSON.
+ * Cached info event data are rendered by it too.
+ */
+
+#undef NDEBUG // Tests rely on assert
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "satellite_priv.h"
+
+static void test_wsat_json_writer()
+{
+  char buffer[256];
+  struct wsat_json_writer writer;
+  if (1) {
+    // Nested objects, every value type and escaping
+    wsat_json_writer_init(&writer, buffer, sizeof(buffer));
+    wsat_json_writer_object_begin(&writer, NULL);
+    wsat_json_writer_string(&writer, "name", "a\"b\\c\nd\x01");
+    wsat_json_writer_object_begin(&writer, "inner");
+    wsat_json_writer_uint(&writer, "zero", 0);
+    wsat_json_writer_uint(&writer, "big", 4407203886274);
+    wsat_json_writer_object_end(&writer);
+    wsat_json_writer_bool(&writer, "yes", true);
+    wsat_json_writer_bool(&writer, "no", false);
+    wsat_json_writer_string(&writer, "missing", NULL);
+    wsat_json_writer_object_end(&writer);
+    assert(!writer.is_overflow);
+    const char* expected = "{\"name\":\"a\\\"b\\\\c\\nd\\u0001\",\"inner\":{\"zero\":0,\"big\":4407203886274},"
+                           "\"yes\":true,\"no\":false,\"missing\":null}";
+    assert(writer.length == strlen(expected));
+    assert(memcmp(buffer, expected, writer.length) == 0);
+    cJSON* parsed = cJSON_ParseWithLength(buffer, writer.length);
+    assert(parsed != NULL);
+    assert(strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(parsed, "name")), "a\"b\\c\nd\x01") == 0);
+    cJSON_Delete(parsed);
+  }
+  if (1) {
+    // Output which doesn't fit is never partially written past the capacity, and overflow is remembered
+    memset(buffer, 'x', sizeof(buffer));
+    wsat_json_writer_init(&writer, buffer, 10);
+    wsat_json_writer_object_begin(&writer, NULL);
+    wsat_json_writer_string(&writer, "text", "too long for the buffer");
+    wsat_json_writer_object_end(&writer);
+    assert(writer.is_overflow);
+    assert(writer.length <= 10);
+    assert(buffer[10] == 'x');
+  }
+  if (1) {
+    // Arrays of values and objects, empty ones too
+    wsat_json_writer_init(&writer, buffer, sizeof(buffer));
+    wsat_json_writer_object_begin(&writer, NULL);
+    wsat_json_writer_array_begin(&writer, "empty");
+    wsat_json_writer_array_end(&writer);
+    wsat_json_writer_array_begin(&writer, "values");
+    wsat_json_writer_string(&writer, NULL, "en");
+    wsat_json_writer_uint(&writer, NULL, 1);
+    wsat_json_writer_object_begin(&writer, NULL);
+    wsat_json_writer_array_begin(&writer, "inner");
+    wsat_json_writer_array_end(&writer);
+    wsat_json_writer_object_end(&writer);
+    wsat_json_writer_array_end(&writer);
+    wsat_json_writer_object_end(&writer);
+    assert(!writer.is_overflow);
+    const char* expected = "{\"empty\":[],\"values\":[\"en\",1,{\"inner\":[]}]}";
+    assert(writer.length == strlen(expected));
+    assert(memcmp(buffer, expected, writer.length) == 0);
+  }
+  if (1) {
+    // Info is rendered once with wake metadata, defaults are used for missing ones
+    static const char* const languages[] = { "en", "sk", NULL };
+    static struct wsat_wake wake = {
+      { WSAT_COMPONENT_TYPE_WAKE, NULL, NULL, NULL, false },
+      "okay_nabu",
+      "okay nabu",
+      .languages = languages,
+    };
+    wsat_init(NULL);
+    wsat_wake_set(&wake);
+    // Info is rendered by wsat_run for the components set
+    wsat_info_render();
+    struct wsat_inst_priv* inst = &wsat_priv;
+    assert(inst->info_data_length > 0);
+    cJSON* parsed = cJSON_ParseWithLength(inst->info_data, inst->info_data_length);
+    assert(parsed != NULL);
+    cJSON* wake_entry = cJSON_GetObjectItem(parsed, "wake")->child;
+    assert(strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(wake_entry, "name")), "microwakeword-c") == 0);
+    cJSON* model = cJSON_GetObjectItem(wake_entry, "models")->child;
+    assert(strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(model, "name")), "okay_nabu") == 0);
+    assert(strcmp(cJSON_GetStringValue(cJSON_GetObjectItem(model, "phrase")), "okay nabu") == 0);
+    cJSON* language = cJSON_GetObjectItem(model, "languages")->child;
+    assert(strcmp(cJSON_GetStringValue(language), "en") == 0);
+    assert(strcmp(cJSON_GetStringValue(language->next), "sk") == 0);
+    assert(language->next->next == NULL);
+    cJSON_Delete(parsed);
+    // Without wake, the list is empty
+    wsat_wake_set(NULL);
+    wsat_info_render();
+    parsed = cJSON_ParseWithLength(inst->info_data, inst->info_data_length);
+    assert(parsed != NULL && cJSON_GetObjectItem(parsed, "wake")->child == NULL);
+    cJSON_Delete(parsed);
+    wsat_destroy();
+  }
+  if (1) {
+    // Header template is valid start of header
+    static const char header[] = WSAT_EVENT_HEADER_TEMPLATE("audio-chunk", "1.5.2");
+    assert(strcmp(header, "{\"type\":\"audio-chunk\",\"version\":\"1.5.2\"") == 0);
+  }
+}
+
+int main()
+{
+  test_wsat_json_writer();
+  printf("test_wsat_json_writer passed\n");
+  return 0;
+}
@@ -0,0 +1,251 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Unit tests of microphone data gathering, blocks of various sizes are written through the mode
+ * and audio-chunk events read from the other end of socket pair must have size within chunk duration bounds.
+ * Chunk size must follow the backlog, as the test reads or doesn't read the other end.
+ * Data written into lent buffer must be sent without being copied into the chunk again. Partial chunk left
+ * when the pipeline ended or satellite was paused must not be sent after it.
+ */
+
+#undef NDEBUG // Tests rely on assert
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "satellite_priv.h"
+
+#if WSAT_MIC_CHUNK_MS > 0
+
+#define TEST_CHUNK_MAX 64
+
+static struct wsat_microphone test_mic = {
+  { WSAT_COMPONENT_TYPE_MICROPHONE, NULL, NULL, NULL, false },
+  16000,
+  2,
+  1,
+};
+
+static uint8_t test_mic_chunk_payload[WSAT_MIC_CHUNK_BUFFER_SIZE]; // Start of last payload read
+
+// Reads audio-chunk events until `total_length` bytes of payload arrive, returns count of them
+static uint32_t test_mic_chunk_read(int fd, uint32_t total_length, uint32_t* chunk_lengths)
+{
+  static struct wsat_event_decoder dec;
+  wsat_event_decoder_reset(&dec);
+  uint32_t count = 0;
+  uint32_t received = 0;
+  while (received < total_length) {
+    struct wsat_buffer_region regions[2];
+    assert(wsat_event_decoder_buffer_get(&dec, regions) > 0);
+    const ssize_t res = recv(fd, regions[0].data, regions[0].length, 0);
+    assert(res > 0); // Timeout means some audio was lost
+    wsat_event_decoder_buffer_advance(&dec, (uint32_t)res);
+    struct wsat_decoded_event* evt;
+    while (wsat_event_decoder_next(&dec, &evt) == 1) {
+      assert(strcmp(evt->header.type, "audio-chunk") == 0);
+      if (evt->flags & WSAT_DECODED_EVENT_FLAG_PAYLOAD) {
+        if (evt->payload.offset < sizeof(test_mic_chunk_payload)) {
+          const uint32_t left = sizeof(test_mic_chunk_payload) - evt->payload.offset;
+          memcpy(test_mic_chunk_payload + evt->payload.offset, evt->payload.data,
+                 evt->payload.size < left ? evt->payload.size : left);
+        }
+        received += evt->payload.size;
+      }
+      if (evt->flags & WSAT_DECODED_EVENT_FLAG_END) {
+        assert(count < TEST_CHUNK_MAX);
+        chunk_lengths[count++] = evt->header.payload_length;
+      }
+      wsat_decoded_event_free(evt);
+    }
+  }
+  assert(received == total_length);
+  return count;
+}
+
+static void test_wsat_mic_chunk()
+{
+  int fds[2];
+  static uint8_t block[4096];
+  uint32_t chunk_lengths[TEST_CHUNK_MAX];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  const struct timeval timeout = { 1, 0 };
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  wsat_init(NULL);
+  struct wsat_inst_priv* inst = &wsat_priv;
+  inst->server.connfd = fds[0];
+  inst->mic = &test_mic;
+  inst->mode = &wsat_mode_always_stream;
+  inst->mode->component.init_fn();
+  wsat_audio_chunk_init();
+#if WSAT_SEND_QUEUE_SIZE > 0
+  assert(wsat_send_queue_start() == WSAT_OK);
+  wsat_send_queue_reset(fds[0]);
+#endif
+  const uint32_t chunk_size = inst->mic_chunk.size;
+  assert(chunk_size == 16000 * 2 * WSAT_MIC_CHUNK_MS / 1000 || chunk_size == WSAT_MIC_CHUNK_BUFFER_SIZE);
+  assert(inst->mic_chunk.min_size <= chunk_size && chunk_size <= inst->mic_chunk.max_size);
+  assert(chunk_size % 2 == 0);
+  if (1) {
+    // Nothing is sent, when not streaming
+    memset(block, 'A', sizeof(block));
+    wsat_mic_write_data(block, 160);
+    assert(inst->mic_chunk.used == 0);
+  }
+  if (1) {
+    // Small blocks are gathered, big one is sent partly directly, rest is sent by explicit flush.
+    // All of it must fit into send queue, as nothing is read until the end, so chunk might grow meanwhile.
+    inst->mode_inst.always_stream.is_streaming = true;
+    uint32_t total_length = 0;
+    for (uint32_t i = 0; i < 30; i++) {
+      wsat_mic_write_data(block, 160);
+      total_length += 160;
+    }
+    wsat_mic_write_data(block, 2 * chunk_size + 100);
+    total_length += 2 * chunk_size + 100;
+    wsat_mic_flush();
+    assert(inst->mic_chunk.used == 0);
+
+    const uint32_t count = test_mic_chunk_read(fds[1], total_length, chunk_lengths);
+    assert(count < 30);
+    for (uint32_t i = 0; i + 1 < count; i++) {
+      assert(chunk_lengths[i] >= inst->mic_chunk.min_size && chunk_lengths[i] <= inst->mic_chunk.max_size);
+      assert(chunk_lengths[i] % 2 == 0);
+    }
+  }
+#if WSAT_MIC_CHUNK_MIN_MS != WSAT_MIC_CHUNK_MAX_MS
+  if (1) {
+    // Idle link, every chunk is received before next one starts, so chunks get as short as allowed
+    inst->mode_inst.always_stream.is_streaming = true;
+    for (uint32_t i = 0; i < 8; i++) {
+      const uint32_t size = inst->mic_chunk.size;
+      wsat_mic_write_data(block, size);
+      wsat_mic_flush(); // Chunk might have shrunk, so the rest of block is still gathered
+      test_mic_chunk_read(fds[1], size, chunk_lengths);
+    }
+    struct wsat_stats stats;
+    wsat_stats_get(&stats);
+    assert(stats.mic.chunk_size == inst->mic_chunk.min_size);
+    assert(stats.mic.chunk_ms == WSAT_MIC_CHUNK_MIN_MS);
+    assert(stats.mic.shrink_count > 0);
+    assert(stats.mic.backlog_bytes < stats.mic.chunk_size);
+  }
+  if (1) {
+    // Audio piling up, as nothing is received, makes chunks longer
+    uint32_t total_length = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+      wsat_mic_write_data(block, 512);
+      total_length += 512;
+    }
+    wsat_mic_flush();
+    struct wsat_stats stats;
+    wsat_stats_get(&stats);
+    assert(stats.mic.grow_count > 0);
+    assert(stats.mic.chunk_size > inst->mic_chunk.min_size);
+    assert(stats.mic.backlog_bytes > 0);
+    test_mic_chunk_read(fds[1], total_length, chunk_lengths);
+  }
+#endif
+  if (1) {
+    // Lent buffer is written in place and sent as it is, data committed while not streaming are not sent
+    uint8_t* buffer;
+    uint32_t length;
+    inst->mode_inst.always_stream.is_streaming = false;
+    assert(wsat_mic_acquire_buffer(&buffer, &length));
+    memset(buffer, 'X', length);
+    wsat_mic_commit(length);
+    assert(inst->mic_chunk.used == 0);
+    inst->mode_inst.always_stream.is_streaming = true;
+    assert(wsat_mic_acquire_buffer(&buffer, &length));
+    assert(buffer == inst->mic_chunk.buffer && length == inst->mic_chunk.size);
+    memset(buffer, 'L', 100);
+    wsat_mic_commit(100);
+    assert(wsat_mic_acquire_buffer(&buffer, &length));
+    assert(buffer == inst->mic_chunk.buffer + 100 && length == inst->mic_chunk.size - 100);
+    memset(buffer, 'L', length);
+    wsat_mic_commit(length);
+    assert(inst->mic_chunk.used == 0);
+    const uint32_t total_length = length + 100;
+    assert(test_mic_chunk_read(fds[1], total_length, chunk_lengths) == 1);
+    assert(chunk_lengths[0] == total_length);
+    assert(test_mic_chunk_payload[0] == 'L' && test_mic_chunk_payload[total_length - 1] == 'L');
+  }
+  if (1) {
+    // Explicit flush sends the rest at once
+    inst->mode_inst.always_stream.is_streaming = true;
+    wsat_mic_write_data(block, 100);
+    wsat_mic_flush();
+    assert(test_mic_chunk_read(fds[1], 100, chunk_lengths) == 1);
+    assert(chunk_lengths[0] == 100);
+  }
+  if (1) {
+    // Audio gathered when satellite was paused is dropped, instead of being sent after pause
+    inst->mode_inst.always_stream.is_streaming = true;
+    wsat_mic_write_data(block, 100);
+    assert(inst->mic_chunk.used == 100);
+    inst->mode->event_handlers[WSAT_EVENT_TYPE_PAUSE_SATELLITE](NULL);
+    wsat_mic_write_data(block, 160);
+    assert(inst->mic_chunk.used == 0);
+  }
+  if (1) {
+    // In wake mode, audio gathered when transcript ended the pipeline is dropped, instead of being sent after it
+    inst->mode->component.destroy_fn();
+    inst->mode = &wsat_mode_wake_stream;
+    inst->mode->component.init_fn();
+    inst->mode_inst.wake_stream.is_streaming = true;
+    memset(block, 'S', 100);
+    wsat_mic_write_data(block, 100);
+    assert(inst->mic_chunk.used == 100);
+    inst->mode->event_handlers[WSAT_EVENT_TYPE_TRANSCRIPT](NULL);
+    wsat_mic_write_data(block, 160);
+    assert(inst->mic_chunk.used == 0);
+    // Next pipeline starts with empty chunk
+    inst->mode_inst.wake_stream.is_streaming = true;
+    memset(block, 'N', 100);
+    wsat_mic_write_data(block, 100);
+    wsat_mic_flush();
+    assert(test_mic_chunk_read(fds[1], 100, chunk_lengths) == 1);
+    assert(chunk_lengths[0] == 100 && test_mic_chunk_payload[0] == 'N');
+  }
+  if (1) {
+    // Lent buffer filled while pipeline ended and next detection started is moved to start of discarded chunk
+    inst->mode_inst.wake_stream.is_streaming = true;
+    memset(block, 'S', 100);
+    wsat_mic_write_data(block, 100);
+    uint8_t* buffer;
+    uint32_t length;
+    assert(wsat_mic_acquire_buffer(&buffer, &length));
+    assert(buffer == inst->mic_chunk.buffer + 100 && length > 100);
+    inst->mode->event_handlers[WSAT_EVENT_TYPE_TRANSCRIPT](NULL);
+    inst->mode_inst.wake_stream.is_streaming = true; // As wake detection does
+    memset(buffer, 'M', length);
+    wsat_mic_commit(length);
+    assert(inst->mic_chunk.used == length);
+    wsat_mic_flush();
+    assert(test_mic_chunk_read(fds[1], length, chunk_lengths) == 1);
+    assert(chunk_lengths[0] == length);
+    for (uint32_t i = 0; i < length; i++) assert(test_mic_chunk_payload[i] == 'M');
+  }
+#if WSAT_SEND_QUEUE_SIZE > 0
+  wsat_send_queue_stop();
+#endif
+  inst->mode->component.destroy_fn();
+  wsat_destroy();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+#endif
+
+int main()
+{
+#if WSAT_MIC_CHUNK_MS > 0
+  test_wsat_mic_chunk();
+  printf("test_wsat_mic_chunk passed\n");
+#else
+  printf("test_wsat_mic_chunk skipped, WSAT_MIC_CHUNK_MS is 0\n");
+#endif
+  return 0;
+}
@@ -0,0 +1,47 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Platform glue shared by tests and benchmarks.
+ * Logs are printed only when WSAT_TEST_VERBOSE environment variable is set, so they don't skew measurements.
+ */
+
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void debug_print(char type, const char* format, ...)
+{
+  static int verbose = -1;
+  if (verbose < 0) verbose = getenv("WSAT_TEST_VERBOSE") != NULL;
+  if (!verbose) return;
+  va_list args;
+  va_start(args, format);
+  printf("[%c] ", type);
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+uint64_t plat_time_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+int plat_sem_take_timeout(sem_t* sem, uint32_t timeout_ms)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += timeout_ms / 1000;
+  ts.tv_nsec += (timeout_ms % 1000) * 1000000l;
+  if (ts.tv_nsec >= 1000000000l) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000l;
+  }
+  return sem_timedwait(sem, &ts);
+}
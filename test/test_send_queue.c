@@ -0,0 +1,156 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Unit tests of the send queue, the send thread writes into one end of socket pair and the test reads the other.
+ * Reading is delayed, so the queue fills up, and control event pushed last must overtake queued audio.
+ * Audio dropped because of the overload policy or its deadline must never break the stream, and audio piled up
+ * in the queue must be written in batches.
+ */
+
+#undef NDEBUG // Tests rely on assert
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "satellite_priv.h"
+
+#if WSAT_SEND_QUEUE_SIZE > 0
+
+#define TEST_BULK_LENGTH 1000
+#define TEST_CONTROL_LENGTH 100
+#define TEST_BULK_MAX 256
+
+static void test_wsat_send_queue()
+{
+  int fds[2];
+  uint8_t unit[TEST_BULK_LENGTH];
+  struct iovec iov = { unit, 0 };
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  const int buffer_size = 4096;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+  wsat_init(NULL);
+  assert(wsat_send_queue_start() == WSAT_OK);
+  wsat_send_queue_reset(fds[0]);
+  if (1) {
+    // Events for other connection are refused
+    iov.iov_len = TEST_CONTROL_LENGTH;
+    assert(wsat_send_queue_push(fds[1], WSAT_SEND_CLASS_CONTROL, PLAT_TIME_US(), &iov, 1) ==
+           -WSAT_ERROR_SAT_DISCONNECTED);
+  }
+  if (1) {
+    // Audio, which waited in queue past its deadline, is not sent
+    memset(unit, 'L', TEST_BULK_LENGTH);
+    iov.iov_len = TEST_BULK_LENGTH;
+    const uint64_t late_us = PLAT_TIME_US() - (WSAT_SEND_DEADLINE_BULK_MS + 1) * 1000ull;
+    assert(wsat_send_queue_push(fds[0], WSAT_SEND_CLASS_BULK, late_us, &iov, 1) == WSAT_OK);
+    // Wait until send thread takes it, so it's not dropped by overload below instead
+    struct wsat_send_stats stats;
+    for (int i = 0; i < 100; i++) {
+      memset(&stats, 0, sizeof(stats));
+      wsat_send_queue_stats_get(&stats);
+      if (stats.bulk.queue_depth == 0) break;
+      usleep(10 * 1000);
+    }
+    assert(stats.bulk.queue_depth == 0);
+  }
+#if WSAT_SEND_OVERLOAD_POLICY != WSAT_SEND_OVERLOAD_BLOCK // Every push would wait until the deadline
+  if (1) {
+    // Push more audio than fits, overload policy drops some, then push control event
+    uint32_t pushed_count = 0;
+    for (uint32_t seq = 0; seq < TEST_BULK_MAX; seq++) {
+      memset(unit, 'B', TEST_BULK_LENGTH);
+      unit[1] = (uint8_t)seq;
+      iov.iov_len = TEST_BULK_LENGTH;
+      const int32_t res = wsat_send_queue_push(fds[0], WSAT_SEND_CLASS_BULK, PLAT_TIME_US(), &iov, 1);
+      assert(res == WSAT_OK || res == -WSAT_ERROR_SEND_QUEUE_FULL);
+      pushed_count += res == WSAT_OK;
+    }
+    memset(unit, 'C', TEST_CONTROL_LENGTH);
+    iov.iov_len = TEST_CONTROL_LENGTH;
+    assert(wsat_send_queue_push(fds[0], WSAT_SEND_CLASS_CONTROL, PLAT_TIME_US(), &iov, 1) == WSAT_OK);
+
+    // Only producers drop for overload, so the count is final now
+    struct wsat_send_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    wsat_send_queue_stats_get(&stats);
+    assert(stats.bulk.overload_drop_count > 0);
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_DROP_OLDEST
+    assert(pushed_count == TEST_BULK_MAX);
+    const uint32_t expected_bulk_count = pushed_count - stats.bulk.overload_drop_count;
+#else
+    assert(pushed_count + stats.bulk.overload_drop_count == TEST_BULK_MAX);
+    const uint32_t expected_bulk_count = pushed_count;
+#endif
+    const uint32_t expected_length = expected_bulk_count * TEST_BULK_LENGTH + TEST_CONTROL_LENGTH;
+
+    // Read everything and split it back to units, they must come whole and in order, except the control one
+    static uint8_t received[TEST_BULK_MAX * TEST_BULK_LENGTH];
+    uint32_t received_length = 0;
+    while (received_length < expected_length) {
+      const ssize_t res = recv(fds[1], received + received_length, sizeof(received) - received_length, 0);
+      assert(res > 0);
+      received_length += res;
+    }
+    assert(received_length == expected_length);
+    int32_t last_seq = -1;
+    uint32_t bulk_after_control = 0;
+    bool is_control_received = false;
+    for (uint32_t offset = 0; offset < received_length;) {
+      if (received[offset] == 'C') {
+        for (uint32_t i = 0; i < TEST_CONTROL_LENGTH; i++) assert(received[offset + i] == 'C');
+        is_control_received = true;
+        offset += TEST_CONTROL_LENGTH;
+        continue;
+      }
+      assert(received[offset] == 'B');
+      const int32_t seq = received[offset + 1];
+      assert(seq > last_seq);
+      last_seq = seq;
+      if (is_control_received) bulk_after_control++;
+      offset += TEST_BULK_LENGTH;
+    }
+    assert(is_control_received);
+    // Queue was full of audio, when control event was pushed
+    assert(bulk_after_control > 0);
+#if WSAT_SEND_OVERLOAD_POLICY == WSAT_SEND_OVERLOAD_DROP_OLDEST
+    assert(last_seq == TEST_BULK_MAX - 1); // Newest audio is kept
+#endif
+
+    // Statistics are updated by the send thread after the write, give it a moment
+    for (int i = 0; i < 100; i++) {
+      memset(&stats, 0, sizeof(stats));
+      stats.control = wsat_priv.server.send_stats.control;
+      stats.bulk = wsat_priv.server.send_stats.bulk;
+      wsat_send_queue_stats_get(&stats);
+      if (stats.control.sent_count > 0 && stats.bulk.queue_depth == 0) break;
+      usleep(10 * 1000);
+    }
+    assert(stats.bulk.queue_high_water <= WSAT_SEND_QUEUE_SIZE);
+    assert(stats.control.overload_drop_count == 0);
+    assert(stats.control.sent_count == 1);
+    // Audio queued while the socket was full goes out in batches
+    assert(stats.bulk.sent_count > 0 && stats.bulk.sent_count < expected_bulk_count);
+    assert(stats.bulk.deadline_drop_count == 1);
+  }
+#endif
+  wsat_send_queue_stop();
+  wsat_destroy();
+  close(fds[0]);
+  close(fds[1]);
+}
+
+#endif
+
+int main()
+{
+#if WSAT_SEND_QUEUE_SIZE > 0
+  test_wsat_send_queue();
+  printf("test_wsat_send_queue passed\n");
+#else
+  printf("test_wsat_send_queue skipped, WSAT_SEND_QUEUE_SIZE is 0\n");
+#endif
+  return 0;
+}
@@ -0,0 +1,387 @@
+// Copyright 2026 Marek Kraus (@gamelaster / @gamiee)
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Tests of server lifecycle, server is run in its own thread and stopped both while waiting for connection
+ * and while connected. Stop request must wake the loop up at once, and wsat_stop_wait must return only
+ * after everything is closed. Ping must be answered over every transport, and socket options from config
+ * must be applied to the connection. Peer, which stops pinging, must be dropped within peer timeout, and
+ * components must be told about connect and disconnect.
+ */
+
+#undef NDEBUG // Tests rely on assert
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "satellite_priv.h"
+
+#define TEST_UNIX_PATH "/tmp/wsat_test_server.sock"
+
+// Without wakeup channel, stop request is noticed by the next timed poll
+#if WSAT_WAKEUP == WSAT_WAKEUP_NONE
+#define TEST_STOP_MAX_US ((WSAT_SERVER_POLL_MS + 100) * 1000ull)
+#else
+#define TEST_STOP_MAX_US (100 * 1000ull)
+#endif
+
+static int32_t test_run_result;
+static volatile bool test_run_done;
+
+static void* test_run_thread_fn(void* opaque)
+{
+  (void)opaque;
+  test_run_result = wsat_run();
+  test_run_done = true;
+  return NULL;
+}
+
+// Connects to the server, once it listens on port picked by system
+static int test_server_connect()
+{
+  struct wsat_server* server = &wsat_priv.server;
+  struct sockaddr_in addr;
+  socklen_t addr_length = sizeof(addr);
+  int sockfd = -1;
+  for (uint32_t i = 0; i < 200 && sockfd < 0 && !test_run_done; i++) {
+    PLAT_MUTEX_LOCK(&server->state_mutex);
+    sockfd = server->sockfd;
+    PLAT_MUTEX_UNLOCK(&server->state_mutex);
+    if (sockfd < 0) usleep(10 * 1000);
+  }
+  assert(sockfd >= 0);
+  assert(getsockname(sockfd, (struct sockaddr*)&addr, &addr_length) == 0);
+  assert(addr.sin_port != 0);
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+  return fd;
+}
+
+static int test_sockopt_get(int fd, int level, int name)
+{
+  int value = 0;
+  socklen_t length = sizeof(value);
+  assert(getsockopt(fd, level, name, &value, &length) == 0);
+  return value;
+}
+
+static bool test_server_is_connected()
+{
+  struct wsat_server* server = &wsat_priv.server;
+  PLAT_MUTEX_LOCK(&server->state_mutex);
+  const bool is_connected = server->connfd >= 0;
+  PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  return is_connected;
+}
+
+// Waits until server is connected, or ended
+static bool test_server_connected_wait()
+{
+  for (uint32_t i = 0; i < 200 && !test_run_done; i++) {
+    if (test_server_is_connected()) return true;
+    usleep(10 * 1000);
+  }
+  return false;
+}
+
+static uint64_t test_stop_wait_us()
+{
+  const uint64_t start_us = PLAT_TIME_US();
+  wsat_stop_wait();
+  return PLAT_TIME_US() - start_us;
+}
+
+// Receives the next event with client end of `transport`
+static struct wsat_decoded_event* test_event_receive(const struct wsat_transport* transport, int fd)
+{
+  static struct wsat_event_decoder dec;
+  wsat_event_decoder_reset(&dec);
+  struct wsat_decoded_event* evt = NULL;
+  while (evt == NULL) {
+    assert(transport->wait_fn(fd, false, -1, 1000) == 1);
+    struct wsat_buffer_region regions[2];
+    assert(wsat_event_decoder_buffer_get(&dec, regions) > 0);
+    struct iovec iov = { regions[0].data, regions[0].length };
+    const int32_t res = transport->read_fn(fd, &iov, 1);
+    assert(res > 0);
+    wsat_event_decoder_buffer_advance(&dec, (uint32_t)res);
+    if (wsat_event_decoder_next(&dec, &evt) != 1) evt = NULL;
+  }
+  return evt;
+}
+
+static void test_wsat_server()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  pthread_t thread;
+  struct wsat_config config;
+  wsat_config_default_get(&config);
+  assert(config.port == 10700 && config.is_nodelay);
+  config.address = "127.0.0.1";
+  config.port = 0;
+  config.receive_buffer_size = 32 * 1024;
+  config.keepalive_idle_s = 30;
+  config.keepalive_interval_s = 5;
+  config.keepalive_count = 3;
+  wsat_init(&config);
+  if (1) {
+    // Connection gets options from config
+    test_run_done = false;
+    pthread_create(&thread, NULL, test_run_thread_fn, NULL);
+    const int fd = test_server_connect();
+    assert(test_server_connected_wait());
+    PLAT_MUTEX_LOCK(&server->state_mutex);
+    const int connfd = server->connfd;
+    assert(test_sockopt_get(connfd, IPPROTO_TCP, TCP_NODELAY) != 0);
+    assert(test_sockopt_get(connfd, SOL_SOCKET, SO_RCVBUF) >= 32 * 1024);
+    assert(test_sockopt_get(connfd, SOL_SOCKET, SO_KEEPALIVE) != 0);
+#ifdef TCP_KEEPIDLE
+    assert(test_sockopt_get(connfd, IPPROTO_TCP, TCP_KEEPIDLE) == 30);
+#endif
+#ifdef TCP_KEEPCNT
+    assert(test_sockopt_get(connfd, IPPROTO_TCP, TCP_KEEPCNT) == 3);
+#endif
+#ifdef TCP_USER_TIMEOUT
+    assert(test_sockopt_get(connfd, IPPROTO_TCP, TCP_USER_TIMEOUT) == 10 * 1000);
+#endif
+    PLAT_MUTEX_UNLOCK(&server->state_mutex);
+    // User header of any size is sent with lengths, whether it fits into space before data or not
+    const uint32_t note_lengths[] = { WSAT_SEND_HEADER_MAX_SIZE / 2, WSAT_SEND_HEADER_MAX_SIZE * 2 };
+    for (uint32_t i = 0; i < ARRAY_LENGTH(note_lengths); i++) {
+      char note[WSAT_SEND_HEADER_MAX_SIZE * 2 + 1];
+      memset(note, 'x', note_lengths[i]);
+      note[note_lengths[i]] = '\0';
+      uint8_t payload[4] = { 1, 2, 3, 4 };
+      struct wsat_event evt = { cJSON_CreateObject(), cJSON_CreateObject(), payload, sizeof(payload) };
+      cJSON_AddStringToObject(evt.header, "type", "big-header");
+      cJSON_AddStringToObject(evt.header, "note", note);
+      cJSON_AddStringToObject(evt.data, "text", "hello");
+      assert(wsat_event_send(&evt) == WSAT_OK);
+      cJSON_Delete(evt.header);
+      cJSON_Delete(evt.data);
+      struct wsat_decoded_event* received = test_event_receive(&wsat_transport_tcp, fd);
+      assert(strcmp(received->header.type, "big-header") == 0);
+      assert(received->header.data_length == strlen("{\"text\":\"hello\"}"));
+      assert(received->header.payload_length == sizeof(payload));
+      assert(memcmp(received->data_span.json, "{\"text\":\"hello\"}", received->header.data_length) == 0);
+      wsat_decoded_event_free(received);
+    }
+    // Connected, but idle server is stopped at once, connection is closed by then
+    usleep(50 * 1000); // Let the loop fall asleep
+    assert(test_stop_wait_us() < TEST_STOP_MAX_US);
+    assert(server->connfd == -1 && server->sockfd == -1);
+    assert(server->wakeup_fds[0] == -1 && server->wakeup_fds[1] == -1);
+    char byte;
+    assert(recv(fd, &byte, 1, 0) == 0); // Server closed its end
+    close(fd);
+    pthread_join(thread, NULL);
+    assert(test_run_result == WSAT_OK);
+  }
+  if (1) {
+    // Server waiting for connection is stopped at once, and can be run again
+    test_run_done = false;
+    pthread_create(&thread, NULL, test_run_thread_fn, NULL);
+    const int fd = test_server_connect();
+    assert(test_server_connected_wait());
+    close(fd); // Server goes back to waiting for connection
+    for (uint32_t i = 0; i < 200 && test_server_is_connected(); i++) usleep(10 * 1000);
+    assert(!test_server_is_connected());
+    usleep(50 * 1000);
+    assert(test_stop_wait_us() < TEST_STOP_MAX_US);
+    pthread_join(thread, NULL);
+    assert(test_run_result == WSAT_OK);
+  }
+  wsat_destroy();
+}
+
+// Connects to server listening on Unix domain socket
+static int test_unix_connect()
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, TEST_UNIX_PATH);
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+  close(fd);
+  return -1;
+}
+
+// Sends ping with client end of `transport` and checks that pong comes back
+static void test_ping(const struct wsat_transport* transport, int fd)
+{
+  static const char ping[] = "{\"type\":\"ping\",\"version\":\"1.7.2\"}\n";
+  struct iovec iov = { (void*)ping, sizeof(ping) - 1 };
+  assert(transport->writev_fn(fd, &iov, 1, false) == sizeof(ping) - 1);
+  struct wsat_decoded_event* evt = test_event_receive(transport, fd);
+  assert(strcmp(evt->header.type, "pong") == 0);
+  wsat_decoded_event_free(evt);
+}
+
+static void test_wsat_server_transports()
+{
+  pthread_t thread;
+  struct wsat_config config;
+  wsat_config_default_get(&config);
+  config.address = TEST_UNIX_PATH;
+  wsat_init(&config);
+#if WSAT_TRANSPORT_UNIX
+  if (1) {
+    // Anything else than socket at the path is left alone, and server doesn't start
+    wsat_transport_set(&wsat_transport_unix);
+    FILE* file = fopen(TEST_UNIX_PATH, "w");
+    assert(file != NULL);
+    fclose(file);
+    assert(wsat_run() < 0);
+    struct stat path_stat;
+    assert(lstat(TEST_UNIX_PATH, &path_stat) == 0 && S_ISREG(path_stat.st_mode));
+    unlink(TEST_UNIX_PATH);
+  }
+  if (1) {
+    // Unix domain socket
+    wsat_transport_set(&wsat_transport_unix);
+    test_run_done = false;
+    pthread_create(&thread, NULL, test_run_thread_fn, NULL);
+    int fd = -1;
+    for (uint32_t i = 0; i < 200 && fd < 0; i++) {
+      fd = test_unix_connect();
+      if (fd < 0) usleep(10 * 1000);
+    }
+    assert(fd >= 0);
+    test_ping(&wsat_transport_unix, fd);
+    wsat_stop_wait();
+    pthread_join(thread, NULL);
+    assert(test_run_result == WSAT_OK);
+    close(fd);
+    unlink(TEST_UNIX_PATH);
+  }
+#endif
+#if WSAT_WAKEUP != WSAT_WAKEUP_NONE
+  if (1) {
+    // In-process loopback, connection is refused until server listens, and while another client is connected
+    const struct wsat_transport* transport = &wsat_transport_loopback;
+    wsat_transport_set(transport);
+    test_run_done = false;
+    pthread_create(&thread, NULL, test_run_thread_fn, NULL);
+    int fd = -1;
+    for (uint32_t i = 0; i < 200 && fd < 0; i++) {
+      fd = wsat_transport_loopback_connect();
+      if (fd < 0) usleep(10 * 1000);
+    }
+    assert(fd >= 0);
+    assert(wsat_transport_loopback_connect() < 0);
+    test_ping(transport, fd);
+    test_ping(transport, fd);
+    usleep(50 * 1000);
+    assert(test_stop_wait_us() < TEST_STOP_MAX_US);
+    pthread_join(thread, NULL);
+    assert(test_run_result == WSAT_OK);
+    // Server end is closed, so client reads end of stream
+    struct iovec iov = { &(char){ 0 }, 1 };
+    assert(transport->wait_fn(fd, false, -1, 0) == 1);
+    assert(transport->read_fn(fd, &iov, 1) == 0);
+    transport->close_fn(fd);
+  }
+#endif
+  wsat_destroy();
+}
+
+static volatile uint32_t test_connect_count;
+static volatile uint32_t test_disconnect_count;
+
+static int32_t test_snd_sys_event_handle(enum wsat_sys_event_type type, void* data)
+{
+  (void)data;
+  if (type == WSAT_SYS_EVENT_SAT_CONNECT) test_connect_count++;
+  if (type == WSAT_SYS_EVENT_SAT_DISCONNECT) test_disconnect_count++;
+  return 0;
+}
+
+static struct wsat_sound test_snd = {
+  { WSAT_COMPONENT_TYPE_SOUND, NULL, NULL, test_snd_sys_event_handle, false },
+  NULL,
+  NULL,
+};
+
+static void test_wsat_server_liveness()
+{
+  struct wsat_inst_priv* inst = &wsat_priv;
+  struct wsat_server* server = &inst->server;
+  pthread_t thread;
+  struct wsat_config config;
+  wsat_config_default_get(&config);
+  config.address = "127.0.0.1";
+  config.port = 0;
+  config.peer_timeout_s = 1;
+  wsat_init(&config);
+  wsat_snd_set(&test_snd);
+  test_connect_count = test_disconnect_count = 0;
+  test_run_done = false;
+  pthread_create(&thread, NULL, test_run_thread_fn, NULL);
+  const int fd = test_server_connect();
+  assert(test_server_connected_wait());
+  if (1) {
+    // Keepalive is derived from peer timeout
+    PLAT_MUTEX_LOCK(&server->state_mutex);
+    assert(test_sockopt_get(server->connfd, SOL_SOCKET, SO_KEEPALIVE) != 0);
+#ifdef TCP_KEEPIDLE
+    assert(test_sockopt_get(server->connfd, IPPROTO_TCP, TCP_KEEPIDLE) == 1);
+#endif
+    PLAT_MUTEX_UNLOCK(&server->state_mutex);
+  }
+  if (1) {
+    // Peer, which never pinged, is not expected to ping
+    usleep(1300 * 1000);
+    assert(test_server_is_connected());
+    assert(test_connect_count == 1 && test_disconnect_count == 0);
+  }
+  if (1) {
+    // Once peer pinged, silence longer than peer timeout drops it
+    test_ping(&wsat_transport_tcp, fd);
+    const uint64_t ping_us = PLAT_TIME_US();
+    for (uint32_t i = 0; i < 300 && test_server_is_connected(); i++) usleep(10 * 1000);
+    const uint64_t dropped_after_us = PLAT_TIME_US() - ping_us;
+    assert(!test_server_is_connected());
+#ifndef WSAT_TIME_NOT_MEASURED
+    assert(dropped_after_us >= 900 * 1000 && dropped_after_us < 1500 * 1000);
+#else
+    (void)dropped_after_us; // Silence is counted by timed out waits of server loop, which is not exact
+#endif
+    char byte;
+    assert(recv(fd, &byte, 1, 0) == 0); // Server closed its end
+    close(fd);
+    for (uint32_t i = 0; i < 100 && test_disconnect_count == 0; i++) usleep(10 * 1000);
+    assert(test_connect_count == 1 && test_disconnect_count == 1);
+  }
+  if (1) {
+    // Server keeps running and the next connection is told to components too
+    const int next_fd = test_server_connect();
+    assert(test_server_connected_wait());
+    for (uint32_t i = 0; i < 100 && test_connect_count < 2; i++) usleep(10 * 1000);
+    assert(test_connect_count == 2);
+    wsat_stop_wait();
+    assert(test_disconnect_count == 2);
+    close(next_fd);
+  }
+  pthread_join(thread, NULL);
+  assert(test_run_result == WSAT_OK);
+  wsat_destroy();
+}
+
+int main()
+{
+  test_wsat_server_transports();
+  printf("test_wsat_server_transports passed\n");
+  test_wsat_server();
+  printf("test_wsat_server passed\n");
+  test_wsat_server_liveness();
+  printf("test_wsat_server_liveness passed\n");
+  return 0;
+}